@@ -0,0 +1,145 @@
+// Loopback check for the 429/503 handling of the admission controller: a
+// local listener throttles the first responses and the program verifies the
+// retries, the concurrency window and the Retry-After cap. Exits non-zero
+// if any case fails.
+//
+// g++ -std=c++11 -O2 -I../src -o admission_check admission_check.cpp -lcpprest -lssl -lcrypto -lpthread -lboost_system
+// ./admission_check
+
+#include "OpenDataHubAPI.h"
+#include <cpprest/http_listener.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace web::http::experimental::listener;
+
+static const char* kBase = "http://127.0.0.1:34571";
+static const char* kApiBase = "http://127.0.0.1:34571/v2";
+
+// What the listener answers: the first throttled requests get status, with
+// Retry-After if retry_after is set; the rest get an empty page. With
+// together set the throttled requests are held and answered at once, after
+// the last of them has arrived.
+struct Script {
+    status_code status = status_codes::OK;
+    int throttled = 0;
+    std::string retry_after;
+    bool together = false;
+};
+
+static Script script;
+static std::atomic<int> received(0);
+static std::mutex held_mutex;
+static std::vector<http_request> held;
+
+static void throttle(http_request request) {
+    http_response response(script.status);
+    if (!script.retry_after.empty()) response.headers().add(U("Retry-After"), utility::conversions::to_string_t(script.retry_after));
+    request.reply(response);
+}
+
+static int failures = 0;
+
+static void expect(bool condition, const std::string& what) {
+    std::cout << (condition ? "  ok    " : "  FAIL  ") << what << std::endl;
+    if (!condition) ++failures;
+}
+
+// Runs one uncached call against a fresh client so every case starts with
+// a full concurrency window.
+static json::value run(const char* name, const Script& next, const AdmissionOptions& options, std::unique_ptr<OpenDataHubAPI>& api) {
+    std::cout << name << std::endl;
+    script = next;
+    received = 0;
+    api.reset(new OpenDataHubAPI(1, kApiBase));
+    api->set_admission_options(options);
+    return api->get_latest_measurements().get();
+}
+
+int main() {
+    http_listener listener(U(kBase));
+    listener.support(methods::GET, [](http_request request) {
+        int n = ++received;
+        if (n <= script.throttled && script.together) {
+            std::vector<http_request> burst;
+            {
+                std::lock_guard<std::mutex> lock(held_mutex);
+                held.push_back(request);
+                if (n == script.throttled) burst.swap(held);
+            }
+            for (auto& r : burst) throttle(r);
+            return;
+        }
+        if (n <= script.throttled) {
+            throttle(request);
+            return;
+        }
+        request.reply(status_codes::OK, json::value::parse(U("{\"offset\":0,\"data\":[],\"limit\":200}")));
+    });
+    listener.open().wait();
+
+    std::unique_ptr<OpenDataHubAPI> api;
+    AdmissionOptions options;
+    options.base_backoff = std::chrono::milliseconds(10);
+    options.max_backoff = std::chrono::seconds(2);
+
+    Script too_many;
+    too_many.status = 429;
+    too_many.throttled = 2;
+    too_many.retry_after = "0";
+    json::value result = run("429 with Retry-After", too_many, options, api);
+    expect(!result.has_field(U("error")), "succeeds after retrying");
+    expect(received == 3, "sent 3 requests");
+    expect(api->concurrency_limit() < options.initial_concurrency, "concurrency window shrank");
+
+    // Every request of the burst was admitted before the first 429 came
+    // back, so together they count as one congestion event.
+    std::cout << "16 concurrent 429s" << std::endl;
+    Script burst = too_many;
+    burst.throttled = 16;
+    burst.together = true;
+    script = burst;
+    received = 0;
+    api.reset(new OpenDataHubAPI(1, kApiBase));
+    api->set_admission_options(options);
+    std::vector<pplx::task<json::value>> calls;
+    for (int i = 0; i < 16; ++i) calls.push_back(api->get_latest_measurements("flat,node", "*", "*", 200, i));
+    bool all_succeeded = true;
+    for (auto& call : calls) all_succeeded = !call.get().has_field(U("error")) && all_succeeded;
+    expect(all_succeeded, "every call succeeds after retrying");
+    expect(received == 32, "sent 32 requests");
+    expect(api->concurrency_limit() >= options.initial_concurrency / 2 && api->concurrency_limit() < options.initial_concurrency,
+           "concurrency window halved once");
+
+    Script unavailable;
+    unavailable.status = status_codes::ServiceUnavailable;
+    unavailable.throttled = 2;
+    result = run("503 without Retry-After", unavailable, options, api);
+    expect(!result.has_field(U("error")), "succeeds after backing off");
+    expect(received == 3, "sent 3 requests");
+
+    Script long_wait = too_many;
+    long_wait.retry_after = "3600";
+    auto started = std::chrono::steady_clock::now();
+    result = run("429 with Retry-After above max_backoff", long_wait, options, api);
+    expect(result.has_field(U("error")) && result.at(U("error")).as_string() == U("HTTP Error: 429"), "returns the 429");
+    expect(received == 1, "does not retry");
+    expect(std::chrono::steady_clock::now() - started < options.max_backoff, "returns without waiting");
+
+    Script overloaded = unavailable;
+    overloaded.throttled = 100;
+    options.max_retries = 2;
+    result = run("503 until retries run out", overloaded, options, api);
+    expect(result.has_field(U("error")) && result.at(U("error")).as_string() == U("HTTP Error: 503"), "returns the 503");
+    expect(received == 3, "sent 3 requests");
+
+    api.reset();
+    listener.close().wait();
+    std::cout << (failures ? "FAILED" : "passed") << std::endl;
+    return failures ? 1 : 0;
+}
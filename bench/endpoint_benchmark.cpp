@@ -0,0 +1,212 @@
+// End-to-end benchmark of the endpoint methods against a local ReplayServer:
+// calls/sec, p50/p90/p99 latency, heap allocations per call and RSS per
+// endpoint. Record the responses once from the live API, then replay them
+// offline as often as needed. The server runs in a forked child process,
+// so allocations and RSS are the client's alone.
+//
+// g++ -std=c++11 -O2 -I../src -o endpoint_benchmark endpoint_benchmark.cpp -lcpprest -lssl -lcrypto -lpthread -lboost_system
+// mkdir recordings && ./endpoint_benchmark record recordings
+// ./endpoint_benchmark replay recordings [calls] [concurrency] [latency_ms] [bytes_per_second]
+
+#include "OpenDataHubAPI.h"
+#include "ReplayServer.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static const char* kReplayBase = "http://127.0.0.1:34570/v2";
+
+// One endpoint call; resolves to false if the call came back with an error.
+struct Case {
+    const char* name;
+    std::function<pplx::task<bool>(OpenDataHubAPI& api)> call;
+};
+
+static bool succeeded(const json::value& result) { return !result.has_field(U("error")); }
+static bool columns_succeeded(const MeasurementColumns& columns) { return columns.error.empty(); }
+
+static std::vector<Case> cases() {
+    const std::string from = "2024-01-01T00:00:00.000";
+    const std::string to = "2024-01-02T00:00:00.000";
+    return {
+        { "get_entry_points", [](OpenDataHubAPI& api) { return api.get_entry_points().then(succeeded); } },
+        { "get_categories", [](OpenDataHubAPI& api) { return api.get_categories().then(succeeded); } },
+        { "get_stations", [](OpenDataHubAPI& api) { return api.get_stations().then(succeeded); } },
+        { "get_edges", [](OpenDataHubAPI& api) { return api.get_edges().then(succeeded); } },
+        { "get_stations_with_data_types", [](OpenDataHubAPI& api) { return api.get_stations_with_data_types().then(succeeded); } },
+        { "get_latest_measurements", [](OpenDataHubAPI& api) { return api.get_latest_measurements().then(succeeded); } },
+        { "get_latest_measurement_columns", [](OpenDataHubAPI& api) { return api.get_latest_measurement_columns().then(columns_succeeded); } },
+        { "get_historical_measurements", [from, to](OpenDataHubAPI& api) {
+            return api.get_historical_measurements("flat,node", "*", "*", from, to).then(succeeded);
+        } },
+        { "get_historical_measurement_columns", [from, to](OpenDataHubAPI& api) {
+            return api.get_historical_measurement_columns("flat,node", "*", "*", from, to).then(columns_succeeded);
+        } },
+        { "stream_historical_measurements", [from, to](OpenDataHubAPI& api) {
+            return api.stream_historical_measurements([](const json::value&) {}, "flat,node", "*", "*", from, to).then(succeeded);
+        } },
+        { "get_metadata_history", [from, to](OpenDataHubAPI& api) {
+            return api.get_metadata_history("flat,node", "*", from, to).then(succeeded);
+        } },
+        { "get_events", [](OpenDataHubAPI& api) { return api.get_events().then(succeeded); } },
+        { "get_latest_events", [](OpenDataHubAPI& api) { return api.get_latest_events().then(succeeded); } },
+        { "get_events_at_timepoint", [from](OpenDataHubAPI& api) {
+            return api.get_events_at_timepoint("flat,event", "*", from).then(succeeded);
+        } },
+        { "get_events_in_interval", [from, to](OpenDataHubAPI& api) {
+            return api.get_events_in_interval("flat,event", "*", from, to).then(succeeded);
+        } },
+    };
+}
+
+static double rss_mb() {
+    long pages = 0, resident = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(statm);
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024 * 1024);
+}
+
+static double peak_rss_mb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Returns false if any call failed: the API answered with an error, or
+// the recording could not be written.
+static bool record(const std::string& directory) {
+    auto recorder = std::make_shared<RecordingTransport>(
+        std::make_shared<HttpTransport>(DEFAULT_API_BASE, default_client_config(), 4), directory);
+    OpenDataHubAPI api(recorder);
+    bool all_ok = true;
+    for (const auto& c : cases()) {
+        bool ok = c.call(api).get();
+        std::cout << c.name << (ok ? "  recorded" : "  FAILED (error response or recording not written)") << std::endl;
+        all_ok = ok && all_ok;
+    }
+    return all_ok;
+}
+
+static void run(OpenDataHubAPI& api, const Case& c, int calls, int concurrency) {
+    c.call(api).wait();
+
+    std::vector<double> latencies;
+    std::mutex latencies_mutex;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    size_t allocations_before = allocations.load();
+    auto started = std::chrono::steady_clock::now();
+
+    for (int w = 0; w < concurrency; ++w) {
+        workers.emplace_back([&, w]() {
+            std::vector<double> local;
+            for (int i = w; i < calls; i += concurrency) {
+                auto t0 = std::chrono::steady_clock::now();
+                if (!c.call(api).get()) ++failures;
+                local.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+            }
+            std::lock_guard<std::mutex> lock(latencies_mutex);
+            latencies.insert(latencies.end(), local.begin(), local.end());
+        });
+    }
+    for (auto& t : workers) t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    size_t allocated = allocations.load() - allocations_before;
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << c.name
+              << "  calls/s=" << static_cast<long>(latencies.size() / seconds)
+              << "  p50=" << latencies[latencies.size() / 2] << "us"
+              << "  p90=" << latencies[latencies.size() * 9 / 10] << "us"
+              << "  p99=" << latencies[latencies.size() * 99 / 100] << "us"
+              << "  allocs/call=" << allocated / latencies.size()
+              << "  rss=" << rss_mb() << "MB"
+              << "  peak=" << peak_rss_mb() << "MB";
+    if (failures) std::cout << "  errors=" << failures.load();
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " record|replay <directory> [calls] [concurrency] [latency_ms] [bytes_per_second]" << std::endl;
+        return 1;
+    }
+    std::string mode = argv[1];
+    std::string directory = argv[2];
+    if (mode == "record") {
+        return record(directory) ? 0 : 1;
+    }
+
+    int calls = argc > 3 ? std::atoi(argv[3]) : 1000;
+    int concurrency = argc > 4 ? std::atoi(argv[4]) : 8;
+    ReplayOptions options;
+    options.latency = std::chrono::milliseconds(argc > 5 ? std::atoi(argv[5]) : 0);
+    options.bytes_per_second = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : 0;
+
+    // Forked before any cpprest thread exists. The child reports through
+    // ready once it listens and stops when stop is closed.
+    int ready[2], stop[2];
+    if (pipe(ready) != 0 || pipe(stop) != 0) {
+        std::perror("pipe");
+        return 1;
+    }
+    pid_t server_pid = fork();
+    if (server_pid < 0) {
+        std::perror("fork");
+        return 1;
+    }
+    if (server_pid == 0) {
+        ::close(ready[0]);
+        ::close(stop[1]);
+        ReplayServer server(kReplayBase, directory, options);
+        server.open().wait();
+        char byte = 1;
+        if (::write(ready[1], &byte, 1) != 1) _exit(1);
+        while (::read(stop[0], &byte, 1) > 0) {}
+        server.close().wait();
+        _exit(0);
+    }
+    ::close(ready[1]);
+    ::close(stop[0]);
+    char byte = 0;
+    if (::read(ready[0], &byte, 1) != 1) {
+        std::cerr << "replay server failed to start" << std::endl;
+        waitpid(server_pid, nullptr, 0);
+        return 1;
+    }
+
+    {
+        OpenDataHubAPI api(4, kReplayBase);
+        // Every call should reach the server.
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) api.set_cache_ttl(static_cast<Endpoint>(e), std::chrono::milliseconds(0));
+        for (const auto& c : cases()) run(api, c, calls, concurrency);
+    }
+    ::close(stop[1]);
+    waitpid(server_pid, nullptr, 0);
+    return 0;
+}
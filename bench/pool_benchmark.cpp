@@ -0,0 +1,72 @@
+// Loopback benchmark for HttpClientPool: requests/sec and p50/p99 latency
+// with pooling on (persistent clients) and off (new client per request).
+//
+// g++ -std=c++11 -O2 -I../src -o pool_benchmark pool_benchmark.cpp -lcpprest -lssl -lcrypto -lpthread -lboost_system
+// ./pool_benchmark [requests] [concurrency] [pool_size]
+
+#include "HttpClientPool.h"
+#include <cpprest/http_listener.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace web;
+using namespace web::http;
+using namespace web::http::client;
+using namespace web::http::experimental::listener;
+
+static const char* kBase = "http://127.0.0.1:34568";
+
+static void run(const char* label, size_t pool_size, int requests, int concurrency) {
+    http_client_config config;
+    HttpClientPool pool(kBase, config, pool_size);
+
+    std::vector<double> latencies;
+    std::mutex latencies_mutex;
+    std::vector<std::thread> workers;
+    auto started = std::chrono::steady_clock::now();
+
+    for (int w = 0; w < concurrency; ++w) {
+        workers.emplace_back([&, w]() {
+            std::vector<double> local;
+            for (int i = w; i < requests; i += concurrency) {
+                auto t0 = std::chrono::steady_clock::now();
+                auto client = pool.acquire();
+                client->request(methods::GET, U("/")).then([](http_response r) { return r.extract_json(); }).wait();
+                local.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+            }
+            std::lock_guard<std::mutex> lock(latencies_mutex);
+            latencies.insert(latencies.end(), local.begin(), local.end());
+        });
+    }
+    for (auto& t : workers) t.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << label
+              << "  req/s=" << static_cast<long>(latencies.size() / seconds)
+              << "  p50=" << latencies[latencies.size() / 2] << "us"
+              << "  p99=" << latencies[latencies.size() * 99 / 100] << "us" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int requests = argc > 1 ? std::atoi(argv[1]) : 5000;
+    int concurrency = argc > 2 ? std::atoi(argv[2]) : 8;
+    size_t pool_size = argc > 3 ? std::atoi(argv[3]) : 4;
+
+    http_listener listener(U(kBase));
+    listener.support(methods::GET, [](http_request request) {
+        request.reply(status_codes::OK, json::value::parse(U("{\"offset\":0,\"data\":[],\"limit\":200}")));
+    });
+    listener.open().wait();
+
+    run("pool off", 0, requests, concurrency);
+    run("pool on ", pool_size, requests, concurrency);
+
+    listener.close().wait();
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Microbenchmark for URL construction: the former std::map +
+// encode_data_string chain against RequestBuilder, reporting ns and heap
+// allocations per request path.
+//
+// g++ -std=c++11 -O2 -I../src -o request_builder_benchmark request_builder_benchmark.cpp -lcpprest -lssl -lcrypto -lpthread -lboost_system
+// ./request_builder_benchmark [iterations]
+
+#include "RequestBuilder.h"
+#include <cpprest/http_client.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+
+static std::atomic<size_t> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+static std::string encode(const std::string& value) {
+    return utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(value)));
+}
+
+// The URL construction get_historical_measurements used before RequestBuilder.
+static std::string legacy_path(const std::string& representation, const std::string& stationTypes, const std::string& dataTypes,
+                               const std::string& from, const std::string& to, int limit, int offset, const std::string& where) {
+    std::map<std::string, std::string> params;
+    if (limit != 200) params["limit"] = std::to_string(limit);
+    if (offset != 0) params["offset"] = std::to_string(offset);
+    if (!where.empty()) params["where"] = encode(where);
+
+    std::string query;
+    if (!params.empty()) {
+        query = "?";
+        bool first = true;
+        for (const auto& param : params) {
+            if (!first) query += "&";
+            query += param.first + "=" + encode(param.second);
+            first = false;
+        }
+    }
+    return "/" + encode(representation) + "/" + encode(stationTypes) + "/" + encode(dataTypes) + "/" + encode(from) + "/" + encode(to) + query;
+}
+
+template <typename F>
+static void measure(const char* label, int iterations, F build) {
+    size_t checksum = 0;
+    for (int i = 0; i < 1000; ++i) checksum += build(i);
+
+    size_t before = allocations.load();
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) checksum += build(i);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count();
+    size_t allocated = allocations.load() - before;
+
+    std::cout << label << "  " << ns / iterations << " ns/request  "
+              << static_cast<double>(allocated) / iterations << " allocations/request  (" << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const std::string representation = "flat,node", stationTypes = "EnvironmentStation", dataTypes = "CO2,temperature";
+    const std::string from = "2024-01-01T00:00:00", to = "2024-02-01T00:00:00", where = "scode.eq.\"NOI:FreeSoftwareLab-Temperature\"";
+
+    measure("legacy ", iterations, [&](int i) {
+        return legacy_path(representation, stationTypes, dataTypes, from, to, 1000, i * 1000, where).size();
+    });
+
+    RequestBuilder builder;
+    measure("builder", iterations, [&](int i) {
+        return builder.reset().segment(representation).segment(stationTypes).segment(dataTypes).segment(from).segment(to)
+            .query(1000, i * 1000, "", where, false, true).str().size();
+    });
+    return 0;
+}
@@ -0,0 +1,192 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include "TimerQueue.h"
+#include <pplx/pplx.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+struct AdmissionOptions {
+    // Token bucket: sustained requests per second (0 = unlimited) and the
+    // number of requests that may be sent back to back after idling.
+    double requests_per_second = 0;
+    double burst = 10;
+    // AIMD concurrency window: grows by one per window of successful
+    // responses and halves on a 429/503, at most once per window: overload
+    // signals from requests admitted before the last decrease are ignored.
+    double initial_concurrency = 16;
+    double min_concurrency = 1;
+    double max_concurrency = 64;
+    // Retries for 429/503 responses. Without a Retry-After header the delay
+    // is drawn uniformly from [0, min(max_backoff, base_backoff * 2^attempt)].
+    int max_retries = 3;
+    std::chrono::milliseconds base_backoff = std::chrono::milliseconds(200);
+    std::chrono::milliseconds max_backoff = std::chrono::seconds(10);
+};
+
+// Client-side admission control shared by every request of one
+// OpenDataHubAPI: a token bucket for the request rate and an additive-
+// increase/multiplicative-decrease cap on requests in flight. Waiting is
+// done with TimerQueue and task_completion_events, never by blocking a
+// pplx worker.
+class AdmissionController {
+public:
+    enum class Outcome { Success, Overloaded, Failed };
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    AdmissionOptions options;
+    std::shared_ptr<TimerQueue> timers;
+
+    std::mutex mutex;
+    double tokens;
+    clock::time_point last_refill;
+    double concurrency_limit;
+    size_t in_flight = 0;
+    // Bumped on every decrease; requests carry the value from admission.
+    uint64_t decrease_epoch = 0;
+    struct Waiter {
+        uint64_t id;
+        pplx::task_completion_event<uint64_t> slot;
+    };
+    uint64_t next_waiter = 0;
+    std::deque<Waiter> waiting;
+
+    // Takes a token, possibly going into debt, and returns how long the
+    // caller has to wait until that token would have been available.
+    clock::duration reserve_token() {
+        if (options.requests_per_second <= 0) return clock::duration::zero();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_refill).count();
+        last_refill = now;
+        tokens = std::min(options.burst, tokens + elapsed * options.requests_per_second);
+        tokens -= 1;
+        if (tokens >= 0) return clock::duration::zero();
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(-tokens / options.requests_per_second));
+    }
+
+    // A canceled waiter leaves the queue; a slot already granted is kept
+    // and released by the caller as usual.
+    pplx::task<uint64_t> acquire_slot(const pplx::cancellation_token& token) {
+        Waiter waiter;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (in_flight < static_cast<size_t>(concurrency_limit)) {
+                ++in_flight;
+                return pplx::task_from_result(decrease_epoch);
+            }
+            waiter.id = next_waiter++;
+            waiting.push_back(waiter);
+        }
+        auto granted = pplx::create_task(waiter.slot);
+        cancel_until_done(token, granted, [this, waiter]() {
+            bool removed = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto it = waiting.begin(); it != waiting.end(); ++it) {
+                    if (it->id == waiter.id) {
+                        waiting.erase(it);
+                        removed = true;
+                        break;
+                    }
+                }
+            }
+            if (removed) waiter.slot.set_exception(pplx::task_canceled());
+        });
+        return granted;
+    }
+
+public:
+    AdmissionController(const AdmissionOptions& admission_options, std::shared_ptr<TimerQueue> timer_queue)
+        : options(admission_options), timers(timer_queue), tokens(admission_options.burst),
+          last_refill(clock::now()), concurrency_limit(admission_options.initial_concurrency) {
+        options.min_concurrency = std::max(options.min_concurrency, 1.0);
+        options.max_concurrency = std::max(options.max_concurrency, options.min_concurrency);
+        concurrency_limit = std::min(std::max(concurrency_limit, options.min_concurrency), options.max_concurrency);
+    }
+
+    AdmissionController(const AdmissionController&) = delete;
+    AdmissionController& operator=(const AdmissionController&) = delete;
+
+    // Completes once the request may be sent, with the ticket to pass to
+    // release(). Every successful acquire() must be matched by one release().
+    // Canceling token ends the wait for a slot or a rate token with
+    // task_canceled; a slot granted by then is released here.
+    pplx::task<uint64_t> acquire(const pplx::cancellation_token& token = pplx::cancellation_token::none()) {
+        return acquire_slot(token).then([this, token](uint64_t ticket) {
+            auto wait = reserve_token();
+            if (wait <= clock::duration::zero()) return pplx::task_from_result(ticket);
+            return timers->delay(wait, token).then([this, ticket](pplx::task<void> waited) {
+                try {
+                    waited.get();
+                } catch (...) {
+                    release(Outcome::Failed, ticket);
+                    throw;
+                }
+                return ticket;
+            });
+        });
+    }
+
+    void release(Outcome outcome, uint64_t ticket) {
+        std::vector<pplx::task_completion_event<uint64_t>> admitted;
+        uint64_t epoch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --in_flight;
+            if (outcome == Outcome::Success) {
+                concurrency_limit = std::min(options.max_concurrency, concurrency_limit + 1.0 / concurrency_limit);
+            } else if (outcome == Outcome::Overloaded && ticket == decrease_epoch) {
+                concurrency_limit = std::max(options.min_concurrency, concurrency_limit / 2);
+                ++decrease_epoch;
+            }
+            while (!waiting.empty() && in_flight < static_cast<size_t>(concurrency_limit)) {
+                admitted.push_back(waiting.front().slot);
+                waiting.pop_front();
+                ++in_flight;
+            }
+            epoch = decrease_epoch;
+        }
+        for (auto& slot : admitted) slot.set(epoch);
+    }
+
+    // Delay before retry number attempt + 1, or a negative duration if the
+    // request should not be retried. retry_after is the raw Retry-After
+    // header value; only the delta-seconds form is understood. A server
+    // asking for more than max_backoff is not retried: the caller gets the
+    // 429/503 instead of a stalled call.
+    std::chrono::milliseconds retry_delay(int attempt, const std::string& retry_after) const {
+        if (attempt >= options.max_retries) return std::chrono::milliseconds(-1);
+
+        if (!retry_after.empty()) {
+            char* end = nullptr;
+            long seconds = std::strtol(retry_after.c_str(), &end, 10);
+            if (end != retry_after.c_str() && *end == '\0' && seconds >= 0) {
+                std::chrono::milliseconds wait = std::chrono::seconds(seconds);
+                return wait <= options.max_backoff ? wait : std::chrono::milliseconds(-1);
+            }
+        }
+
+        static thread_local std::mt19937 random(std::random_device{}());
+        auto ceiling = std::min<long long>(options.max_backoff.count(), options.base_backoff.count() << std::min(attempt, 20));
+        std::uniform_int_distribution<long long> jitter(0, std::max<long long>(ceiling, 0));
+        return std::chrono::milliseconds(jitter(random));
+    }
+
+    double current_concurrency_limit() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return concurrency_limit;
+    }
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef AGGREGATION_H
+#define AGGREGATION_H
+
+#include "MeasurementColumns.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct AggregateOptions {
+    // Extra where filter applied before aggregating.
+    std::string where;
+    // Queries with at most this many buckets ask the API for one aggregate
+    // per bucket; larger ones (and 0) download the rows and reduce locally.
+    size_t max_pushdown_buckets = 48;
+};
+
+// min/max/sum/count per (station, time bucket) of one data type. Cell
+// station * bucket_count + bucket holds bucket [from_ms + bucket * bucket_ms,
+// from_ms + (bucket + 1) * bucket_ms); empty cells have count 0 and NaN
+// min/max.
+struct Aggregates {
+    int64_t from_ms = 0;
+    int64_t bucket_ms = 0;
+    size_t bucket_count = 0;
+    StringInterner stations;
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> sum;
+    std::vector<uint64_t> count;
+    // True when the buckets were computed upstream.
+    bool pushed_down = false;
+    // Set instead of throwing when a request behind this result failed.
+    std::string error;
+
+    Aggregates() {}
+
+    Aggregates(int64_t from, int64_t to, int64_t bucket)
+        : from_ms(from), bucket_ms(bucket),
+          bucket_count(to > from && bucket > 0 ? static_cast<size_t>((to - from + bucket - 1) / bucket) : 0) {}
+
+    size_t cell(uint32_t station, size_t bucket) const { return station * bucket_count + bucket; }
+    int64_t bucket_start(size_t bucket) const { return from_ms + static_cast<int64_t>(bucket) * bucket_ms; }
+
+    double avg(uint32_t station, size_t bucket) const {
+        size_t i = cell(station, bucket);
+        return count[i] ? sum[i] / count[i] : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    uint32_t add_station(const std::string& code) {
+        uint32_t id = stations.intern(code);
+        size_t cells = stations.size() * bucket_count;
+        if (min.size() < cells) {
+            min.resize(cells, std::numeric_limits<double>::quiet_NaN());
+            max.resize(cells, std::numeric_limits<double>::quiet_NaN());
+            sum.resize(cells, 0.0);
+            count.resize(cells, 0);
+        }
+        return id;
+    }
+
+    void merge(size_t i, double run_min, double run_max, double run_sum, uint64_t run_count) {
+        if (run_count == 0) return;
+        if (count[i] == 0 || run_min < min[i]) min[i] = run_min;
+        if (count[i] == 0 || run_max > max[i]) max[i] = run_max;
+        sum[i] += run_sum;
+        count[i] += run_count;
+    }
+};
+
+// One row of a pushed-down aggregate response.
+struct AggregateRow {
+    std::string station;
+    double min = 0;
+    double max = 0;
+    double sum = 0;
+    uint64_t count = 0;
+};
+
+// Rows of one pushed-down bucket. complete is false if any row lacked
+// the aggregates.
+struct AggregateRows {
+    std::vector<AggregateRow> rows;
+    bool complete = true;
+    std::string error;
+};
+
+// Select expression for AggregateRow; the API groups by the plain fields.
+inline const char* aggregate_select() {
+    return "scode,min(mvalue),max(mvalue),sum(mvalue),count(mvalue)";
+}
+
+// Decodes one flat record returned for aggregate_select(). Returns false
+// if any aggregate is missing, i.e. the API ignored the select.
+inline bool parse_aggregate_row(const char* record, size_t length, AggregateRow& row) {
+    int seen = 0;
+    for_each_json_field(record, length, [&](const char* key, size_t key_length, const char* text, size_t text_length, bool is_string) {
+        if (key_length == 5 && std::memcmp(key, "scode", 5) == 0) {
+            row.station.assign(text, text_length);
+            seen |= 1;
+            return;
+        }
+        char number[64];
+        if (is_string || text_length == 0 || text_length >= sizeof(number)) return;
+        std::memcpy(number, text, text_length);
+        number[text_length] = '\0';
+        double value = std::strtod(number, nullptr);
+
+        if (key_length == 11 && std::memcmp(key, "min(mvalue)", 11) == 0) {
+            row.min = value;
+            seen |= 2;
+        } else if (key_length == 11 && std::memcmp(key, "max(mvalue)", 11) == 0) {
+            row.max = value;
+            seen |= 4;
+        } else if (key_length == 11 && std::memcmp(key, "sum(mvalue)", 11) == 0) {
+            row.sum = value;
+            seen |= 8;
+        } else if (key_length == 13 && std::memcmp(key, "count(mvalue)", 13) == 0) {
+            row.count = static_cast<uint64_t>(value);
+            seen |= 16;
+        }
+    });
+    return seen == 31;
+}
+
+// Reduces values[0, n) with four independent accumulators per statistic so
+// the loop has no carried dependency the compiler cannot vectorize.
+inline void reduce_run(const double* values, size_t n, double& run_min, double& run_max, double& run_sum) {
+    double min0 = values[0], min1 = values[0], min2 = values[0], min3 = values[0];
+    double max0 = values[0], max1 = values[0], max2 = values[0], max3 = values[0];
+    double sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        min0 = values[i] < min0 ? values[i] : min0;
+        min1 = values[i + 1] < min1 ? values[i + 1] : min1;
+        min2 = values[i + 2] < min2 ? values[i + 2] : min2;
+        min3 = values[i + 3] < min3 ? values[i + 3] : min3;
+        max0 = values[i] > max0 ? values[i] : max0;
+        max1 = values[i + 1] > max1 ? values[i + 1] : max1;
+        max2 = values[i + 2] > max2 ? values[i + 2] : max2;
+        max3 = values[i + 3] > max3 ? values[i + 3] : max3;
+        sum0 += values[i];
+        sum1 += values[i + 1];
+        sum2 += values[i + 2];
+        sum3 += values[i + 3];
+    }
+    for (; i < n; ++i) {
+        min0 = values[i] < min0 ? values[i] : min0;
+        max0 = values[i] > max0 ? values[i] : max0;
+        sum0 += values[i];
+    }
+    min0 = min1 < min0 ? min1 : min0;
+    min2 = min3 < min2 ? min3 : min2;
+    max0 = max1 > max0 ? max1 : max0;
+    max2 = max3 > max2 ? max3 : max2;
+    run_min = min2 < min0 ? min2 : min0;
+    run_max = max2 > max0 ? max2 : max0;
+    run_sum = (sum0 + sum1) + (sum2 + sum3);
+}
+
+// Adds the rows of columns with type type_id (UINT32_MAX for all) to out.
+// Every row is first mapped to its cell in one branch-free pass; rows
+// outside the range or without a numeric value get no cell. Consecutive
+// rows with the same cell - the common case, since a series arrives in
+// time order - are then reduced together by reduce_run.
+inline void aggregate_columns(const MeasurementColumns& columns, Aggregates& out, uint32_t type_id = UINT32_MAX) {
+    const uint64_t none = std::numeric_limits<uint64_t>::max();
+    size_t n = columns.size();
+    if (n == 0 || out.bucket_count == 0) return;
+
+    std::vector<uint64_t> station_cell(columns.stations.size());
+    for (uint32_t s = 0; s < columns.stations.size(); ++s) {
+        station_cell[s] = out.cell(out.add_station(columns.stations.name(s)), 0);
+    }
+
+    const int64_t* timestamps = columns.timestamps.data();
+    const double* values = columns.values.data();
+    const uint32_t* station_ids = columns.station_ids.data();
+    const uint32_t* type_ids = columns.type_ids.data();
+    const uint64_t span = static_cast<uint64_t>(out.bucket_count) * static_cast<uint64_t>(out.bucket_ms);
+    const uint64_t bucket_ms = static_cast<uint64_t>(out.bucket_ms);
+    std::vector<uint64_t> cells(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t offset = static_cast<uint64_t>(timestamps[i] - out.from_ms);
+        bool keep = offset < span && values[i] == values[i] && (type_id == UINT32_MAX || type_ids[i] == type_id);
+        cells[i] = keep ? station_cell[station_ids[i]] + offset / bucket_ms : none;
+    }
+
+    for (size_t i = 0; i < n;) {
+        size_t end = i + 1;
+        while (end < n && cells[end] == cells[i]) ++end;
+        if (cells[i] != none) {
+            double run_min, run_max, run_sum;
+            reduce_run(values + i, end - i, run_min, run_max, run_sum);
+            out.merge(cells[i], run_min, run_max, run_sum, end - i);
+        }
+        i = end;
+    }
+}
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef CALL_OPTIONS_H
+#define CALL_OPTIONS_H
+
+#include <pplx/pplx.h>
+#include <chrono>
+#include <functional>
+
+// Per-call settings. OpenDataHubAPI methods started on a thread while a
+// ScopedCallOptions is alive there pick them up; see co_call in Coroutine.h.
+struct CallOptions {
+    typedef std::function<void(const std::function<void()>& work)> Executor;
+
+    // Cancels the call's HTTP requests, its wait for admission and pending
+    // retries.
+    pplx::cancellation_token token = pplx::cancellation_token::none();
+    // Cancels the call this long after it starts; 0 means no deadline.
+    std::chrono::milliseconds timeout = std::chrono::milliseconds(0);
+    // Runs awaiting coroutines when the call completes; empty resumes them
+    // on the pplx worker that runs the completion continuation.
+    Executor executor;
+};
+
+// Makes options current on this thread for the lifetime of the scope.
+// Only requests started synchronously inside the scope see them; paged
+// calls capture them when they start and apply them to every page.
+// Cached endpoints ignore token and timeout because their fetch may be
+// shared with other callers.
+class ScopedCallOptions {
+private:
+    const CallOptions* previous;
+
+    static const CallOptions*& slot() {
+        static thread_local const CallOptions* current = nullptr;
+        return current;
+    }
+
+public:
+    explicit ScopedCallOptions(const CallOptions& options) : previous(slot()) { slot() = &options; }
+    ~ScopedCallOptions() { slot() = previous; }
+
+    ScopedCallOptions(const ScopedCallOptions&) = delete;
+    ScopedCallOptions& operator=(const ScopedCallOptions&) = delete;
+
+    // Innermost options on this thread, or nullptr.
+    static const CallOptions* current() { return slot(); }
+};
+
+#endif
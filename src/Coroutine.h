@@ -0,0 +1,198 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include "CallOptions.h"
+
+// C++20 coroutine front end for the pplx-based API. Everything below is
+// compiled only when the compiler supports coroutines.
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <pplx/pplx.h>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Awaits a pplx::task without blocking a thread. Suspending registers one
+// task.then continuation, which pplx schedules on its thread pool; the
+// coroutine is resumed from there, or handed to executor when one is set.
+// That is one pool hop per co_await, two with an executor. A task that has
+// already finished does not suspend.
+template <typename T>
+class TaskAwaiter {
+private:
+    pplx::task<T> task;
+    CallOptions::Executor executor;
+
+public:
+    TaskAwaiter(pplx::task<T> task, CallOptions::Executor executor)
+        : task(std::move(task)), executor(std::move(executor)) {}
+
+    bool await_ready() const { return task.is_done(); }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        CallOptions::Executor run = executor;
+        task.then([handle, run](pplx::task<T>) {
+            if (run) {
+                run([handle]() { handle.resume(); });
+            } else {
+                handle.resume();
+            }
+        });
+    }
+
+    T await_resume() { return task.get(); }
+};
+
+template <typename T>
+TaskAwaiter<T> awaitable(pplx::task<T> task, CallOptions::Executor executor = CallOptions::Executor()) {
+    return TaskAwaiter<T>(std::move(task), std::move(executor));
+}
+
+// Starts call() - any OpenDataHubAPI method - with options current, and
+// returns an awaiter for its task:
+//   json::value latest = co_await co_call(options, [&] { return api.get_latest_measurements(); });
+// Cancellation and deadlines end the call with the usual in-band error.
+template <typename F>
+auto co_call(const CallOptions& options, F call) -> TaskAwaiter<typename decltype(call())::result_type> {
+    ScopedCallOptions scope(options);
+    return awaitable(call(), options.executor);
+}
+
+// co_await resume_on(executor) continues the coroutine on executor, e.g.
+// to get back onto an event loop thread before touching its state.
+struct ResumeOn {
+    CallOptions::Executor executor;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        executor([handle]() { handle.resume(); });
+    }
+    void await_resume() {}
+};
+
+inline ResumeOn resume_on(CallOptions::Executor executor) {
+    return ResumeOn{ std::move(executor) };
+}
+
+template <typename T>
+class Async;
+
+namespace coroutine_detail {
+struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+        auto next = handle.promise().continuation;
+        return next ? next : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    Async<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+    T result() {
+        if (exception) std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    Async<void> get_return_object();
+    void return_void() {}
+    void result() {
+        if (exception) std::rethrow_exception(exception);
+    }
+};
+
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+}
+
+// Lazily started coroutine: the body runs when the Async is awaited, and
+// the awaiting coroutine is resumed directly when it finishes, without
+// going through the pplx scheduler. Use to_task to start one from
+// non-coroutine code.
+template <typename T>
+class Async {
+public:
+    typedef coroutine_detail::Promise<T> promise_type;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit Async(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    Async(Async&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Async(const Async&) = delete;
+    Async& operator=(const Async&) = delete;
+    ~Async() {
+        if (handle) handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() { return handle.promise().result(); }
+};
+
+namespace coroutine_detail {
+template <typename T>
+Async<T> Promise<T>::get_return_object() {
+    return Async<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Async<void> Promise<void>::get_return_object() {
+    return Async<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+template <typename T>
+Detached drive(Async<T> async, pplx::task_completion_event<T> done) {
+    try {
+        if constexpr (std::is_void<T>::value) {
+            co_await std::move(async);
+            done.set();
+        } else {
+            done.set(co_await std::move(async));
+        }
+    } catch (...) {
+        done.set_exception(std::current_exception());
+    }
+}
+}
+
+// Starts async and returns a task for its result.
+template <typename T>
+pplx::task<T> to_task(Async<T> async) {
+    pplx::task_completion_event<T> done;
+    coroutine_detail::drive(std::move(async), done);
+    return pplx::create_task(done);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef ENDPOINT_H
+#define ENDPOINT_H
+
+#include <cstddef>
+
+// One entry per public query method, used to key per-endpoint settings.
+enum class Endpoint {
+    EntryPoints,
+    Categories,
+    Stations,
+    Edges,
+    StationsWithDataTypes,
+    LatestMeasurements,
+    HistoricalMeasurements,
+    MetadataHistory,
+    Events,
+    LatestEvents,
+    EventsAtTimepoint,
+    EventsInInterval
+};
+
+const size_t ENDPOINT_COUNT = 12;
+
+inline const char* endpoint_name(Endpoint endpoint) {
+    switch (endpoint) {
+    case Endpoint::EntryPoints: return "entry_points";
+    case Endpoint::Categories: return "categories";
+    case Endpoint::Stations: return "stations";
+    case Endpoint::Edges: return "edges";
+    case Endpoint::StationsWithDataTypes: return "stations_with_data_types";
+    case Endpoint::LatestMeasurements: return "latest_measurements";
+    case Endpoint::HistoricalMeasurements: return "historical_measurements";
+    case Endpoint::MetadataHistory: return "metadata_history";
+    case Endpoint::Events: return "events";
+    case Endpoint::LatestEvents: return "latest_events";
+    case Endpoint::EventsAtTimepoint: return "events_at_timepoint";
+    case Endpoint::EventsInInterval: return "events_in_interval";
+    }
+    return "unknown";
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HTTP_CLIENT_POOL_H
+#define HTTP_CLIENT_POOL_H
+
+#include <cpprest/http_client.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Fixed set of long-lived http_client instances handed out round-robin.
+// Each http_client keeps its own keep-alive connections, so reusing them
+// avoids a fresh TCP/TLS handshake per request. The client list is built
+// once in the constructor and never modified, so acquire() is safe to call
+// from any number of pplx continuations concurrently.
+class HttpClientPool {
+private:
+    std::string base_uri;
+    web::http::client::http_client_config client_config;
+    std::vector<std::shared_ptr<web::http::client::http_client>> clients;
+    std::atomic<size_t> next_client;
+
+public:
+    // A pool_size of 0 disables pooling: every acquire() builds a new client.
+    HttpClientPool(const std::string& base, const web::http::client::http_client_config& config, size_t pool_size)
+        : base_uri(base), client_config(config), next_client(0) {
+        for (size_t i = 0; i < pool_size; ++i) {
+            clients.push_back(std::make_shared<web::http::client::http_client>(
+                utility::conversions::to_string_t(base_uri), client_config));
+        }
+    }
+
+    HttpClientPool(const HttpClientPool&) = delete;
+    HttpClientPool& operator=(const HttpClientPool&) = delete;
+
+    std::shared_ptr<web::http::client::http_client> acquire() {
+        if (clients.empty()) {
+            return std::make_shared<web::http::client::http_client>(
+                utility::conversions::to_string_t(base_uri), client_config);
+        }
+        size_t index = next_client.fetch_add(1, std::memory_order_relaxed);
+        return clients[index % clients.size()];
+    }
+
+    size_t size() const { return clients.size(); }
+};
+
+#endif
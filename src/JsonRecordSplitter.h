@@ -0,0 +1,128 @@
+#ifndef JSON_RECORD_SPLITTER_H
+#define JSON_RECORD_SPLITTER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Incremental scanner for responses shaped like {..., "data": [rec, rec, ...], ...}.
+// Bytes are fed as they arrive; every element of the top-level "data" array is
+// reported as its raw JSON text as soon as it is complete. Only a record that
+// straddles two chunks is copied, so memory use is bounded by the largest
+// single record rather than by the response size.
+class JsonRecordSplitter {
+public:
+    typedef std::function<void(const char* record, size_t length)> RecordCallback;
+
+private:
+    RecordCallback on_record;
+    int depth = 0;
+    bool in_string = false;
+    bool escaped = false;
+    bool expect_key = false;
+    bool key_is_data = false;
+    bool in_data = false;
+    bool record_active = false;
+    std::string key;
+    std::string carry;
+    size_t records = 0;
+
+    static bool is_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    void emit(const char* chunk, size_t start, size_t end) {
+        if (carry.empty()) {
+            while (end > start && is_space(chunk[end - 1])) --end;
+            if (end > start) {
+                ++records;
+                on_record(chunk + start, end - start);
+            }
+        } else {
+            carry.append(chunk + start, end - start);
+            while (!carry.empty() && is_space(carry.back())) carry.pop_back();
+            if (!carry.empty()) {
+                ++records;
+                on_record(carry.data(), carry.size());
+            }
+            carry.clear();
+        }
+        record_active = false;
+    }
+
+public:
+    explicit JsonRecordSplitter(const RecordCallback& callback) : on_record(callback) {}
+
+    void feed(const char* chunk, size_t length) {
+        size_t record_start = 0;
+
+        for (size_t i = 0; i < length; ++i) {
+            char c = chunk[i];
+
+            if (in_string) {
+                if (escaped) {
+                    escaped = false;
+                } else if (c == '\\') {
+                    escaped = true;
+                } else if (c == '"') {
+                    in_string = false;
+                    if (depth == 1 && expect_key) {
+                        key_is_data = key == "data";
+                        expect_key = false;
+                    }
+                    continue;
+                }
+                if (depth == 1 && expect_key) key += c;
+                continue;
+            }
+
+            if (in_data && depth == 2 && !record_active && !is_space(c) && c != ',' && c != ']') {
+                record_active = true;
+                record_start = i;
+            }
+
+            switch (c) {
+            case '"':
+                in_string = true;
+                if (depth == 1 && expect_key) key.clear();
+                break;
+            case '{':
+            case '[':
+                ++depth;
+                if (depth == 1) {
+                    expect_key = true;
+                } else if (depth == 2 && c == '[' && key_is_data) {
+                    in_data = true;
+                }
+                break;
+            case '}':
+            case ']':
+                if (in_data && depth == 2) {
+                    if (record_active) emit(chunk, record_start, i);
+                    in_data = false;
+                    key_is_data = false;
+                }
+                --depth;
+                break;
+            case ',':
+                if (depth == 1) {
+                    expect_key = true;
+                    key_is_data = false;
+                } else if (in_data && depth == 2 && record_active) {
+                    emit(chunk, record_start, i);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        if (record_active) {
+            carry.append(chunk + record_start, length - record_start);
+        }
+    }
+
+    size_t record_count() const { return records; }
+};
+
+#endif
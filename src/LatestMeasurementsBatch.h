@@ -0,0 +1,174 @@
+#ifndef LATEST_MEASUREMENTS_BATCH_H
+#define LATEST_MEASUREMENTS_BATCH_H
+
+#include <cpprest/json.h>
+#include <pplx/pplx.h>
+#include "RequestBuilder.h"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One logical latest-measurements query. Each field names a single station
+// type, data type or station code; "*" (or "" for station_code) matches all.
+struct LatestQuery {
+    std::string station_type = "*";
+    std::string data_type = "*";
+    std::string station_code;
+};
+
+// Collects LatestQuery requests and answers them with as few upstream
+// calls as possible: up to max_queries_per_call queries share one call
+// whose station/data type path segments are the union of theirs and whose
+// where filter is the disjunction of their conditions. The flat rows that
+// come back are routed to every query they match.
+// Create with OpenDataHubAPI::latest_measurements_batch.
+class LatestMeasurementsBatch {
+public:
+    // Issues one merged upstream call.
+    typedef std::function<pplx::task<web::json::value>(const std::string& stationTypes, const std::string& dataTypes,
+                                                       const std::string& where)> Fetch;
+
+private:
+    struct Pending {
+        LatestQuery query;
+        pplx::task_completion_event<web::json::value> result;
+    };
+
+    Fetch fetch;
+    size_t max_queries_per_call;
+    std::mutex mutex;
+    std::vector<Pending> pending;
+
+    static std::string condition(const LatestQuery& query) {
+        std::vector<std::string> terms;
+        if (query.station_type != "*") terms.push_back("stype.eq." + quote_where_value(query.station_type));
+        if (query.data_type != "*") terms.push_back("tname.eq." + quote_where_value(query.data_type));
+        if (!query.station_code.empty()) terms.push_back("scode.eq." + quote_where_value(query.station_code));
+        if (terms.empty()) return "";
+        if (terms.size() == 1) return terms[0];
+
+        std::string joined = "and(";
+        for (size_t i = 0; i < terms.size(); ++i) joined += (i ? "," : "") + terms[i];
+        return joined + ")";
+    }
+
+    static std::string path_union(const std::vector<std::string>& values) {
+        std::vector<std::string> unique;
+        for (const auto& value : values) {
+            if (value == "*") return "*";
+            if (std::find(unique.begin(), unique.end(), value) == unique.end()) unique.push_back(value);
+        }
+        std::string joined;
+        for (size_t i = 0; i < unique.size(); ++i) joined += (i ? "," : "") + unique[i];
+        return joined;
+    }
+
+    static bool matches(const LatestQuery& query, const web::json::value& row) {
+        auto field_is = [&row](const utility::char_t* key, const std::string& expected) {
+            return row.has_field(key) && row.at(key).is_string() &&
+                   utility::conversions::to_utf8string(row.at(key).as_string()) == expected;
+        };
+        return (query.station_type == "*" || field_is(U("stype"), query.station_type)) &&
+               (query.data_type == "*" || field_is(U("tname"), query.data_type)) &&
+               (query.station_code.empty() || field_is(U("scode"), query.station_code));
+    }
+
+    void send(std::shared_ptr<std::vector<Pending>> group) {
+        std::vector<std::string> station_types, data_types, conditions;
+        bool unfiltered = false;
+        for (const auto& entry : *group) {
+            station_types.push_back(entry.query.station_type);
+            data_types.push_back(entry.query.data_type);
+            std::string term = condition(entry.query);
+            if (term.empty()) unfiltered = true;
+            if (std::find(conditions.begin(), conditions.end(), term) == conditions.end()) conditions.push_back(term);
+        }
+
+        std::string where;
+        if (!unfiltered) {
+            if (conditions.size() == 1) {
+                where = conditions[0];
+            } else {
+                where = "or(";
+                for (size_t i = 0; i < conditions.size(); ++i) where += (i ? "," : "") + conditions[i];
+                where += ")";
+            }
+        }
+
+        fetch(path_union(station_types), path_union(data_types), where)
+            .then([group](pplx::task<web::json::value> previousTask) {
+                web::json::value response;
+                try {
+                    response = previousTask.get();
+                } catch (const std::exception& e) {
+                    response[U("error")] = web::json::value::string(
+                        U("Exception: ") + utility::conversions::to_string_t(e.what()));
+                    response[U("success")] = web::json::value::boolean(false);
+                }
+
+                if (response.has_field(U("error")) || !response.has_field(U("data")) || !response.at(U("data")).is_array()) {
+                    for (auto& entry : *group) entry.result.set(response);
+                    return;
+                }
+
+                std::vector<std::vector<web::json::value>> rows(group->size());
+                for (const auto& row : response.at(U("data")).as_array()) {
+                    for (size_t i = 0; i < group->size(); ++i) {
+                        if (matches((*group)[i].query, row)) rows[i].push_back(row);
+                    }
+                }
+                for (size_t i = 0; i < group->size(); ++i) {
+                    web::json::value result;
+                    result[U("offset")] = web::json::value::number(0);
+                    result[U("limit")] = web::json::value::number(-1);
+                    result[U("data")] = web::json::value::array(rows[i]);
+                    (*group)[i].result.set(result);
+                }
+            });
+    }
+
+public:
+    LatestMeasurementsBatch(const Fetch& fetch_function, size_t queries_per_call = 50)
+        : fetch(fetch_function), max_queries_per_call(std::max<size_t>(queries_per_call, 1)) {}
+
+    LatestMeasurementsBatch(const LatestMeasurementsBatch&) = delete;
+    LatestMeasurementsBatch& operator=(const LatestMeasurementsBatch&) = delete;
+
+    // The returned task completes after flush() with a response shaped like
+    // get_latest_measurements containing only this query's rows.
+    pplx::task<web::json::value> add(const LatestQuery& query) {
+        Pending entry;
+        entry.query = query;
+        auto result = pplx::create_task(entry.result);
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(entry);
+        return result;
+    }
+
+    pplx::task<web::json::value> add(const std::string& stationType, const std::string& dataType,
+                                     const std::string& stationCode = "") {
+        LatestQuery query;
+        query.station_type = stationType;
+        query.data_type = dataType;
+        query.station_code = stationCode;
+        return add(query);
+    }
+
+    // Sends everything added so far.
+    void flush() {
+        std::vector<Pending> queued;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.swap(pending);
+        }
+        for (size_t start = 0; start < queued.size(); start += max_queries_per_call) {
+            size_t end = std::min(queued.size(), start + max_queries_per_call);
+            send(std::make_shared<std::vector<Pending>>(queued.begin() + start, queued.begin() + end));
+        }
+    }
+};
+
+#endif
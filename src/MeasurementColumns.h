@@ -0,0 +1,275 @@
+#ifndef MEASUREMENT_COLUMNS_H
+#define MEASUREMENT_COLUMNS_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Parses Open Data Hub timestamps ("2024-01-31 13:45:00.000+0000", also
+// accepting 'T', 'Z' and "+01:00") into milliseconds since the Unix epoch.
+inline bool parse_timestamp_ms(const char* text, size_t length, int64_t& out) {
+    auto digits = [&](size_t pos, size_t count, int& value) {
+        if (pos + count > length) return false;
+        value = 0;
+        for (size_t i = pos; i < pos + count; ++i) {
+            if (text[i] < '0' || text[i] > '9') return false;
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+
+    int year, month, day, hour = 0, minute = 0, second = 0, millis = 0;
+    if (!digits(0, 4, year) || length < 10 || text[4] != '-' || !digits(5, 2, month) || text[7] != '-' || !digits(8, 2, day)) {
+        return false;
+    }
+
+    size_t pos = 10;
+    if (pos < length && (text[pos] == ' ' || text[pos] == 'T')) {
+        if (!digits(pos + 1, 2, hour) || pos + 3 >= length || text[pos + 3] != ':' || !digits(pos + 4, 2, minute)) return false;
+        pos += 6;
+        if (pos < length && text[pos] == ':') {
+            if (!digits(pos + 1, 2, second)) return false;
+            pos += 3;
+        }
+        if (pos < length && text[pos] == '.') {
+            ++pos;
+            int scale = 100;
+            while (pos < length && text[pos] >= '0' && text[pos] <= '9') {
+                millis += (text[pos] - '0') * scale;
+                scale /= 10;
+                ++pos;
+            }
+        }
+    }
+
+    int64_t offset_minutes = 0;
+    if (pos < length && (text[pos] == '+' || text[pos] == '-')) {
+        int sign = text[pos] == '-' ? -1 : 1;
+        int oh, om = 0;
+        if (!digits(pos + 1, 2, oh)) return false;
+        pos += 3;
+        if (pos < length && text[pos] == ':') ++pos;
+        if (pos < length && !digits(pos, 2, om)) return false;
+        offset_minutes = sign * (oh * 60 + om);
+    }
+
+    // days_from_civil (Howard Hinnant)
+    int y = year - (month <= 2 ? 1 : 0);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = static_cast<int64_t>(era) * 146097 + static_cast<int64_t>(doe) - 719468;
+
+    out = ((days * 24 + hour) * 60 + minute - offset_minutes) * 60000 + second * 1000 + millis;
+    return true;
+}
+
+// Formats milliseconds since the epoch as "YYYY-MM-DDTHH:MM:SS.mmm" in UTC,
+// the form accepted by the from/to path segments of the API.
+inline std::string format_timestamp(int64_t ms) {
+    int64_t days = ms >= 0 ? ms / 86400000 : (ms - 86399999) / 86400000;
+    int64_t rem = ms - days * 86400000;
+
+    // civil_from_days (Howard Hinnant)
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    unsigned doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t year = static_cast<int64_t>(yoe) + era * 400;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    unsigned day = doy - (153 * mp + 2) / 5 + 1;
+    unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    if (month <= 2) ++year;
+
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%04d-%02u-%02uT%02d:%02d:%02d.%03d",
+             static_cast<int>(year), month, day,
+             static_cast<int>(rem / 3600000), static_cast<int>(rem / 60000 % 60),
+             static_cast<int>(rem / 1000 % 60), static_cast<int>(rem % 1000));
+    return buffer;
+}
+
+// Calls on_field(key, key_length, value, value_length, is_string) for every
+// top-level member of one JSON object given as raw text. String values are
+// passed without their quotes and still escaped; objects and arrays are
+// passed as their raw text. Nothing is allocated.
+template <typename F>
+inline void for_each_json_field(const char* text, size_t length, F on_field) {
+    size_t i = 0;
+    auto skip_space = [&]() {
+        while (i < length && (text[i] == ' ' || text[i] == '\n' || text[i] == '\r' || text[i] == '\t')) ++i;
+    };
+    auto skip_string = [&]() {
+        ++i;
+        while (i < length && text[i] != '"') i += text[i] == '\\' ? 2 : 1;
+    };
+
+    skip_space();
+    if (i >= length || text[i] != '{') return;
+    ++i;
+
+    for (;;) {
+        skip_space();
+        if (i >= length || text[i] != '"') return;
+        size_t key_start = i + 1;
+        skip_string();
+        if (i >= length) return;
+        size_t key_end = i++;
+
+        skip_space();
+        if (i >= length || text[i] != ':') return;
+        ++i;
+        skip_space();
+        if (i >= length) return;
+
+        size_t value_start = i;
+        bool is_string = false;
+        if (text[i] == '"') {
+            is_string = true;
+            skip_string();
+            if (i >= length) return;
+            on_field(text + key_start, key_end - key_start, text + value_start + 1, i - value_start - 1, true);
+            ++i;
+        } else if (text[i] == '{' || text[i] == '[') {
+            int depth = 0;
+            do {
+                if (text[i] == '"') {
+                    skip_string();
+                } else if (text[i] == '{' || text[i] == '[') {
+                    ++depth;
+                } else if (text[i] == '}' || text[i] == ']') {
+                    --depth;
+                }
+                ++i;
+            } while (i < length && depth > 0);
+            on_field(text + key_start, key_end - key_start, text + value_start, i - value_start, false);
+        } else {
+            while (i < length && text[i] != ',' && text[i] != '}' && text[i] != ' ' && text[i] != '\n' && text[i] != '\r' && text[i] != '\t') ++i;
+            on_field(text + key_start, key_end - key_start, text + value_start, i - value_start, is_string);
+        }
+
+        skip_space();
+        if (i >= length || text[i] != ',') return;
+        ++i;
+    }
+}
+
+// Maps strings to dense uint32_t ids.
+class StringInterner {
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+    // Last id returned by the (text, length) overload, and the key buffer
+    // it reuses for lookups.
+    uint32_t last = UINT32_MAX;
+    std::string scratch;
+
+public:
+    uint32_t intern(const std::string& name) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        uint32_t id = static_cast<uint32_t>(names.size());
+        ids.emplace(name, id);
+        names.push_back(name);
+        return id;
+    }
+
+    // Same as intern(std::string(text, length)) without building a string
+    // per call: consecutive records usually repeat the previous name, and
+    // other lookups go through a reused buffer. Only new names allocate.
+    uint32_t intern(const char* text, size_t length) {
+        if (last != UINT32_MAX && names[last].size() == length && std::memcmp(names[last].data(), text, length) == 0) return last;
+        scratch.assign(text, length);
+        last = intern(scratch);
+        return last;
+    }
+
+    // Returns UINT32_MAX if name has not been interned.
+    uint32_t find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it == ids.end() ? UINT32_MAX : it->second;
+    }
+
+    const std::string& name(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+// Struct-of-arrays view of a measurement batch: row i is
+// (timestamps[i], values[i], station_ids[i], type_ids[i]) where the ids
+// index into the stations (by scode) and types (by tname) interners.
+// Non-numeric values are stored as NaN.
+struct MeasurementColumns {
+    std::vector<int64_t> timestamps;
+    std::vector<double> values;
+    std::vector<uint32_t> station_ids;
+    std::vector<uint32_t> type_ids;
+    StringInterner stations;
+    StringInterner types;
+    // Set instead of throwing when the request behind this batch failed.
+    std::string error;
+
+    size_t size() const { return timestamps.size(); }
+
+    void reserve(size_t rows) {
+        timestamps.reserve(rows);
+        values.reserve(rows);
+        station_ids.reserve(rows);
+        type_ids.reserve(rows);
+    }
+
+    void push_back(int64_t timestamp, double value, uint32_t station_id, uint32_t type_id) {
+        timestamps.push_back(timestamp);
+        values.push_back(value);
+        station_ids.push_back(station_id);
+        type_ids.push_back(type_id);
+    }
+
+    // Decodes one flat-representation measurement record (raw JSON object
+    // text with mvalidtime, mvalue, scode, tname) straight into the columns.
+    // scode/tname are interned as they appear on the wire, without unescaping.
+    // Records without a parsable mvalidtime are skipped.
+    bool append_record(const char* record, size_t length) {
+        int64_t timestamp = 0;
+        bool has_timestamp = false;
+        double value = std::numeric_limits<double>::quiet_NaN();
+        const char* station = "";
+        size_t station_length = 0;
+        const char* type = "";
+        size_t type_length = 0;
+
+        for_each_json_field(record, length, [&](const char* key, size_t key_length, const char* text, size_t text_length, bool is_string) {
+            if (key_length == 10 && std::memcmp(key, "mvalidtime", 10) == 0) {
+                has_timestamp = is_string && parse_timestamp_ms(text, text_length, timestamp);
+            } else if (key_length == 6 && std::memcmp(key, "mvalue", 6) == 0) {
+                char number[64];
+                if (!is_string && text_length > 0 && text_length < sizeof(number)) {
+                    std::memcpy(number, text, text_length);
+                    number[text_length] = '\0';
+                    char* end = nullptr;
+                    double parsed = std::strtod(number, &end);
+                    if (end == number + text_length) value = parsed;
+                }
+            } else if (key_length == 5 && std::memcmp(key, "scode", 5) == 0) {
+                station = text;
+                station_length = text_length;
+            } else if (key_length == 5 && std::memcmp(key, "tname", 5) == 0) {
+                type = text;
+                type_length = text_length;
+            }
+        });
+
+        if (!has_timestamp) return false;
+        push_back(timestamp, value, stations.intern(station, station_length), types.intern(type, type_length));
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef MEASUREMENT_TAIL_H
+#define MEASUREMENT_TAIL_H
+
+#include "MeasurementColumns.h"
+#include "OpenDataHubTypes.h"
+#include "RequestBuilder.h"
+#include "TimerQueue.h"
+#include <pplx/pplx.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TailOptions {
+    // The poll interval shrinks towards min_interval while values keep
+    // changing and grows towards max_interval while nothing changes.
+    std::chrono::milliseconds min_interval = std::chrono::seconds(5);
+    std::chrono::milliseconds max_interval = std::chrono::minutes(2);
+    // How far a series may lag behind the newest mvalidtime seen from any
+    // series (clock skew, upload delay) and still be picked up. Every series
+    // that reported within this window is downloaded again on each poll, so
+    // keep it short.
+    std::chrono::milliseconds lookback = std::chrono::minutes(1);
+    // While at most this many series are known, each also gets its own
+    // high-water condition, so a lagging known series is never missed.
+    // Above it the filter would make the URL too long.
+    size_t max_series_filter = 50;
+};
+
+// Polls latest measurements and reports only rows whose mvalidtime is newer
+// than the high-water mark kept for their (station, data type) series.
+// Create with OpenDataHubAPI::tail_latest_measurements; polling stops when
+// stop() is called or the last shared_ptr is released.
+class MeasurementTail : public std::enable_shared_from_this<MeasurementTail> {
+public:
+    // Receives the filter to apply ("" on the first poll) and fetches rows.
+    typedef std::function<pplx::task<MeasurementColumns>(const std::string& where)> PollFunction;
+    typedef std::function<void(const std::vector<Measurement>& deltas)> DeltaCallback;
+    typedef std::function<void(const std::string& error)> ErrorCallback;
+
+private:
+    PollFunction poll_function;
+    DeltaCallback on_delta;
+    ErrorCallback on_error;
+    TailOptions options;
+    std::shared_ptr<TimerQueue> timers;
+
+    std::mutex mutex;
+    // Held while poll_function is called, so stop() can wait for it.
+    std::mutex poll_mutex;
+    std::unordered_map<std::string, int64_t> high_water;
+    int64_t newest = INT64_MIN;
+    std::chrono::milliseconds interval;
+    std::atomic<bool> stopped;
+
+    void schedule_next(std::chrono::milliseconds delay) {
+        if (stopped.load()) return;
+        std::weak_ptr<MeasurementTail> weak = shared_from_this();
+        timers->schedule_after(delay, [weak]() {
+            if (auto self = weak.lock()) self->poll();
+        });
+    }
+
+    void poll() {
+        std::lock_guard<std::mutex> poll_lock(poll_mutex);
+        if (stopped.load()) return;
+
+        std::string where;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            where = filter_locked();
+        }
+
+        std::weak_ptr<MeasurementTail> weak = shared_from_this();
+        poll_function(where).then([weak](pplx::task<MeasurementColumns> previousTask) {
+            auto self = weak.lock();
+            if (!self) return;
+            try {
+                self->apply(previousTask.get());
+            } catch (const std::exception& e) {
+                self->report_error(std::string("Exception: ") + e.what());
+            }
+        });
+    }
+
+    // "" before the first rows; otherwise rows newer than newest - lookback,
+    // or'ed with one condition per known series while there are few.
+    std::string filter_locked() const {
+        if (newest == INT64_MIN) return "";
+        std::string recent = "mvalidtime.gt." + format_timestamp(newest - options.lookback.count());
+        if (high_water.size() > options.max_series_filter) return recent;
+
+        std::string filter = "or(";
+        for (const auto& series : high_water) {
+            size_t separator = series.first.find('\x1f');
+            filter += "and(scode.eq." + quote_where_value(series.first.substr(0, separator)) +
+                      ",tname.eq." + quote_where_value(series.first.substr(separator + 1)) +
+                      ",mvalidtime.gt." + format_timestamp(series.second) + "),";
+        }
+        return filter + recent + ")";
+    }
+
+    void report_error(const std::string& error) {
+        std::chrono::milliseconds next;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            interval = options.max_interval;
+            next = interval;
+        }
+        if (on_error) on_error(error);
+        schedule_next(next);
+    }
+
+    void apply(const MeasurementColumns& columns) {
+        if (!columns.error.empty()) {
+            report_error(columns.error);
+            return;
+        }
+
+        std::vector<Measurement> deltas;
+        std::chrono::milliseconds next;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < columns.size(); ++i) {
+                const std::string& station = columns.stations.name(columns.station_ids[i]);
+                const std::string& type = columns.types.name(columns.type_ids[i]);
+                std::string key = station + '\x1f' + type;
+
+                auto it = high_water.find(key);
+                if (it != high_water.end() && columns.timestamps[i] <= it->second) continue;
+                high_water[key] = columns.timestamps[i];
+                newest = std::max(newest, columns.timestamps[i]);
+
+                Measurement measurement;
+                measurement.station_code = station;
+                measurement.data_type = type;
+                measurement.timestamp_ms = columns.timestamps[i];
+                measurement.value = columns.values[i];
+                deltas.push_back(measurement);
+            }
+
+            if (deltas.empty()) {
+                interval = std::min(options.max_interval, interval * 3 / 2);
+            } else {
+                interval = std::max(options.min_interval, interval / 2);
+            }
+            next = interval;
+        }
+
+        if (!deltas.empty() && on_delta) on_delta(deltas);
+        schedule_next(next);
+    }
+
+public:
+    MeasurementTail(const PollFunction& poll, const DeltaCallback& deltas, const ErrorCallback& errors,
+                    const TailOptions& tail_options, std::shared_ptr<TimerQueue> timer_queue)
+        : poll_function(poll), on_delta(deltas), on_error(errors), options(tail_options),
+          timers(timer_queue), interval(tail_options.min_interval), stopped(false) {}
+
+    MeasurementTail(const MeasurementTail&) = delete;
+    MeasurementTail& operator=(const MeasurementTail&) = delete;
+
+    void start() { schedule_next(std::chrono::milliseconds(0)); }
+
+    // No poll starts after stop() returns, and one already being issued has
+    // been handed off, so the client behind poll_function may go away.
+    void stop() {
+        std::lock_guard<std::mutex> poll_lock(poll_mutex);
+        stopped.store(true);
+    }
+
+    std::chrono::milliseconds current_interval() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return interval;
+    }
+};
+
+#endif
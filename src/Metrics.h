@@ -0,0 +1,280 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "Endpoint.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+
+// Log2-bucketed latency histogram over microseconds. Bucket i counts
+// samples below 2^i us; the last bucket is unbounded. Recording is a few
+// relaxed atomic increments, so it can stay on in production.
+class LatencyHistogram {
+public:
+    static const size_t BUCKETS = 28;
+
+private:
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> total_us;
+
+public:
+    LatencyHistogram() : samples(0), total_us(0) {
+        for (auto& bucket : buckets) bucket.store(0);
+    }
+
+    void record(std::chrono::steady_clock::duration elapsed) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        uint64_t value = us > 0 ? static_cast<uint64_t>(us) : 0;
+        size_t bucket = 0;
+        while (bucket < BUCKETS - 1 && (uint64_t(1) << bucket) <= value) ++bucket;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        samples.fetch_add(1, std::memory_order_relaxed);
+        total_us.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t bucket_count(size_t bucket) const { return buckets[bucket].load(std::memory_order_relaxed); }
+    uint64_t count() const { return samples.load(std::memory_order_relaxed); }
+    uint64_t sum_us() const { return total_us.load(std::memory_order_relaxed); }
+
+    // Upper bound of bucket i in microseconds (the last bucket is open).
+    static uint64_t bucket_limit_us(size_t bucket) { return uint64_t(1) << bucket; }
+};
+
+// The phases cpprest lets us observe. It does not report DNS, connect and
+// TLS handshake separately; those are part of time_to_first_byte.
+enum class Phase {
+    Queue,            // waiting for admission control (rate limit, concurrency, retry backoff)
+    TimeToFirstByte,  // request sent until response headers
+    Body,             // response headers until the body is read
+    Parse,            // JSON parsing or streamed record decoding
+    Total,
+    Count
+};
+
+inline const char* phase_name(Phase phase) {
+    switch (phase) {
+    case Phase::Queue: return "queue";
+    case Phase::TimeToFirstByte: return "ttfb";
+    case Phase::Body: return "body";
+    case Phase::Parse: return "parse";
+    case Phase::Total: return "total";
+    case Phase::Count: break;
+    }
+    return "unknown";
+}
+
+const size_t PHASE_COUNT = static_cast<size_t>(Phase::Count);
+
+// One finished request, as passed to the trace hook.
+struct Span {
+    Endpoint endpoint;
+    std::string path;
+    int status = 0;  // of the last attempt; 0 when it got no response
+    int retries = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration phases[PHASE_COUNT] = {};
+    std::string error;
+};
+
+struct EndpointMetrics {
+    LatencyHistogram latency[PHASE_COUNT];
+    std::atomic<uint64_t> bytes_in;
+    std::atomic<uint64_t> bytes_out;
+    std::atomic<uint64_t> retries;
+    // Responses per status code 100..599, counted per attempt as they
+    // arrive, so a retried 429 shows up next to the final 200; index 0
+    // counts attempts that failed without a response.
+    std::atomic<uint64_t> status_codes[600];
+    std::atomic<int64_t> in_flight;
+
+    EndpointMetrics() : bytes_in(0), bytes_out(0), retries(0), in_flight(0) {
+        for (auto& count : status_codes) count.store(0);
+    }
+
+    // Responses with exactly this code; 0 for transport failures.
+    uint64_t responses(int code) const {
+        return code >= 0 && code < 600 ? status_codes[code].load(std::memory_order_relaxed) : 0;
+    }
+
+    // Responses in one class, e.g. 4 for 4xx.
+    uint64_t responses_in_class(int status_class) const {
+        uint64_t total = 0;
+        for (int code = status_class * 100; code < status_class * 100 + 100 && code < 600; ++code) total += responses(code);
+        return status_class > 0 ? total : 0;
+    }
+};
+
+// Per-endpoint counters, gauges and histograms for one OpenDataHubAPI.
+class Metrics {
+public:
+    typedef std::function<void(const Span& span)> TraceHook;
+
+private:
+    EndpointMetrics endpoints[ENDPOINT_COUNT];
+    std::shared_ptr<TraceHook> trace_hook;
+
+public:
+    Metrics() {}
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    void set_trace_hook(const TraceHook& hook) {
+        std::atomic_store(&trace_hook, hook ? std::make_shared<TraceHook>(hook) : std::shared_ptr<TraceHook>());
+    }
+
+    void started(Endpoint endpoint) {
+        endpoints[static_cast<size_t>(endpoint)].in_flight.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // One attempt got a response with status code, or none (code 0).
+    void responded(Endpoint endpoint, int code) {
+        size_t index = code >= 100 && code < 600 ? static_cast<size_t>(code) : 0;
+        endpoints[static_cast<size_t>(endpoint)].status_codes[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void finished(const Span& span) {
+        auto& metrics = endpoints[static_cast<size_t>(span.endpoint)];
+        metrics.in_flight.fetch_sub(1, std::memory_order_relaxed);
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+            if (span.phases[phase] > std::chrono::steady_clock::duration::zero() || phase == static_cast<size_t>(Phase::Total)) {
+                metrics.latency[phase].record(span.phases[phase]);
+            }
+        }
+        metrics.bytes_in.fetch_add(span.bytes_in, std::memory_order_relaxed);
+        metrics.bytes_out.fetch_add(span.bytes_out, std::memory_order_relaxed);
+        metrics.retries.fetch_add(static_cast<uint64_t>(span.retries), std::memory_order_relaxed);
+
+        auto hook = std::atomic_load(&trace_hook);
+        if (hook) (*hook)(span);
+    }
+
+    const EndpointMetrics& endpoint(Endpoint endpoint) const { return endpoints[static_cast<size_t>(endpoint)]; }
+
+    // Prometheus text exposition of every counter, gauge and histogram.
+    std::string prometheus() const {
+        std::ostringstream out;
+        out << "# TYPE odh_request_duration_seconds histogram\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            const char* name = endpoint_name(static_cast<Endpoint>(e));
+            for (size_t p = 0; p < PHASE_COUNT; ++p) {
+                const auto& histogram = endpoints[e].latency[p];
+                std::string labels = std::string("endpoint=\"") + name + "\",phase=\"" + phase_name(static_cast<Phase>(p)) + "\"";
+                uint64_t cumulative = 0;
+                for (size_t b = 0; b < LatencyHistogram::BUCKETS - 1; ++b) {
+                    cumulative += histogram.bucket_count(b);
+                    out << "odh_request_duration_seconds_bucket{" << labels << ",le=\""
+                        << LatencyHistogram::bucket_limit_us(b) / 1e6 << "\"} " << cumulative << "\n";
+                }
+                out << "odh_request_duration_seconds_bucket{" << labels << ",le=\"+Inf\"} " << histogram.count() << "\n";
+                out << "odh_request_duration_seconds_sum{" << labels << "} " << histogram.sum_us() / 1e6 << "\n";
+                out << "odh_request_duration_seconds_count{" << labels << "} " << histogram.count() << "\n";
+            }
+        }
+
+        out << "# TYPE odh_bytes_received_total counter\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            out << "odh_bytes_received_total{endpoint=\"" << endpoint_name(static_cast<Endpoint>(e)) << "\"} "
+                << endpoints[e].bytes_in.load(std::memory_order_relaxed) << "\n";
+        }
+        out << "# TYPE odh_bytes_sent_total counter\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            out << "odh_bytes_sent_total{endpoint=\"" << endpoint_name(static_cast<Endpoint>(e)) << "\"} "
+                << endpoints[e].bytes_out.load(std::memory_order_relaxed) << "\n";
+        }
+        out << "# TYPE odh_retries_total counter\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            out << "odh_retries_total{endpoint=\"" << endpoint_name(static_cast<Endpoint>(e)) << "\"} "
+                << endpoints[e].retries.load(std::memory_order_relaxed) << "\n";
+        }
+        // One series per code seen so far; code="error" counts transport failures.
+        out << "# TYPE odh_responses_total counter\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            for (int code = 0; code < 600; ++code) {
+                uint64_t count = endpoints[e].responses(code);
+                if (count == 0 && code != 0) continue;
+                out << "odh_responses_total{endpoint=\"" << endpoint_name(static_cast<Endpoint>(e)) << "\",code=\"";
+                if (code == 0) {
+                    out << "error";
+                } else {
+                    out << code;
+                }
+                out << "\"} " << count << "\n";
+            }
+        }
+        out << "# TYPE odh_requests_in_flight gauge\n";
+        for (size_t e = 0; e < ENDPOINT_COUNT; ++e) {
+            out << "odh_requests_in_flight{endpoint=\"" << endpoint_name(static_cast<Endpoint>(e)) << "\"} "
+                << endpoints[e].in_flight.load(std::memory_order_relaxed) << "\n";
+        }
+        return out.str();
+    }
+};
+
+// Timestamps of one request in progress; owned by the continuations that
+// carry the request through admission, transfer and parsing.
+class RequestTrace {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    std::shared_ptr<Metrics> metrics;
+    Span span;
+    clock::time_point phase_start;
+    bool done = false;
+
+public:
+    // Holds on to owner, so a request may finish after its client is gone.
+    RequestTrace(std::shared_ptr<Metrics> owner, Endpoint endpoint, const std::string& path) : metrics(owner) {
+        span.endpoint = endpoint;
+        span.path = path;
+        span.start = clock::now();
+        phase_start = span.start;
+        metrics->started(endpoint);
+    }
+
+    RequestTrace(const RequestTrace&) = delete;
+    RequestTrace& operator=(const RequestTrace&) = delete;
+
+    ~RequestTrace() {
+        if (!done) finish("abandoned");
+    }
+
+    // Ends the current phase and starts the next one.
+    void mark(Phase phase) {
+        auto now = clock::now();
+        span.phases[static_cast<size_t>(phase)] += now - phase_start;
+        phase_start = now;
+    }
+
+    void sent(uint64_t bytes) { span.bytes_out += bytes; }
+    void received(uint64_t bytes) { span.bytes_in += bytes; }
+    // Counts the response of one attempt; the span keeps the last status.
+    void status(int code) {
+        span.status = code;
+        metrics->responded(span.endpoint, code);
+    }
+
+    // Counts an attempt that failed without a response.
+    void failed() {
+        span.status = 0;
+        metrics->responded(span.endpoint, 0);
+    }
+    void retried() { ++span.retries; }
+
+    void finish(const std::string& error = "") {
+        if (done) return;
+        done = true;
+        span.error = error;
+        span.phases[static_cast<size_t>(Phase::Total)] = clock::now() - span.start;
+        metrics->finished(span);
+    }
+};
+
+#endif
@@ -4,21 +4,86 @@
 #include <cpprest/http_client.h>
 #include <cpprest/json.h>
 #include <pplx/pplx.h>
+#include "AdmissionController.h"
+#include "Aggregation.h"
+#include "CallOptions.h"
+#include "Coroutine.h"
+#include "Endpoint.h"
+#include "JsonRecordSplitter.h"
+#include "LatestMeasurementsBatch.h"
+#include "MeasurementTail.h"
+#include "Metrics.h"
+#include "OpenDataHubTypes.h"
+#include "Paginator.h"
+#include "RecordingTransport.h"
+#include "RequestBuilder.h"
+#include "ResponseCache.h"
+#include "TimerQueue.h"
+#include "Transport.h"
+#ifndef _WIN32
+#include "TimeSeriesStore.h"
+#endif
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <map>
+#include <utility>
 #include <vector>
 
 using namespace web;
 using namespace web::http;
 using namespace web::http::client;
 
+const char* const DEFAULT_API_BASE = "https://mobility.api.opendatahub.com/v2";
+
+// Client configuration the pool-size constructor uses.
+inline http_client_config default_client_config() {
+    http_client_config config;
+    config.set_validate_certificates(false);
+    return config;
+}
+
+// Single requests keep their transport, timers and admission state alive
+// themselves, so the client may be destroyed while they are in flight.
+// Composite operations (paging, batches, aggregation, historical series)
+// call back into the client and must finish first; tails must be stopped.
 class OpenDataHubAPI {
 private:
-    std::string api_base = "https://mobility.api.opendatahub.com/v2";
-    http_client_config client_config;
+    std::string api_base;
+    utility::string_t host_header;
+    std::shared_ptr<Transport> transport;
+    std::shared_ptr<ResponseCache> response_cache;
+    std::atomic<long long> cache_ttl_ms[ENDPOINT_COUNT];
+    // Replaced wholesale by set_admission_options; accessed with
+    // std::atomic_load/atomic_store so in-flight requests keep their own.
+    std::shared_ptr<AdmissionController> admission;
+    std::shared_ptr<Metrics> request_metrics;
+    // Cleared once the API rejects an aggregate select.
+    std::atomic<bool> aggregate_pushdown;
+    // Shared with the admission controller, tails and in-flight requests.
+    std::shared_ptr<TimerQueue> timer_queue;
+
+    // What a request needs once it has left the calling thread, held by
+    // value so a request may outlive the OpenDataHubAPI that started it.
+    struct RequestContext {
+        std::shared_ptr<Transport> transport;
+        std::shared_ptr<TimerQueue> timers;
+        std::shared_ptr<AdmissionController> admission;
+        utility::string_t host;
+    };
+
+    RequestContext request_context() const {
+        RequestContext context;
+        context.transport = transport;
+        context.timers = timer_queue;
+        context.admission = std::atomic_load(&admission);
+        context.host = host_header;
+        return context;
+    }
     
-    http_request create_request(const std::string& endpoint, const std::string& method) {
+    static http_request create_request(const utility::string_t& host, const std::string& endpoint, const std::string& method) {
         http_request request;
         
         if (method == "GET") {
@@ -34,49 +99,251 @@ private:
         request.set_request_uri(utility::conversions::to_string_t(endpoint));
         
         // Set headers
-        request.headers().add(U("Host"), U("mobility.api.opendatahub.com"));
+        request.headers().add(U("Host"), host);
         request.headers().add(U("Content-Type"), U("application/json"));
         request.headers().add(U("User-Agent"), U("Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0"));
         
         return request;
     }
     
-    std::string build_query_params(const std::map<std::string, std::string>& params) {
-        if (params.empty()) return "";
-        
-        std::string query = "?";
-        bool first = true;
-        for (const auto& param : params) {
-            if (!param.second.empty()) {
-                if (!first) query += "&";
-                auto encoded_value = web::uri::encode_data_string(utility::conversions::to_string_t(param.second));
-                query += param.first + "=" + utility::conversions::to_utf8string(encoded_value);
-                first = false;
-            }
+    typedef std::function<void(http_request& request)> RequestDecorator;
+
+    static uint64_t request_size(const http_request& request, const std::string& path, const std::string& method) {
+        uint64_t bytes = method.size() + path.size() + 12;
+        for (const auto& header : request.headers()) {
+            bytes += (header.first.size() + header.second.size()) * sizeof(utility::char_t) + 4;
         }
-        return query;
+        return bytes;
     }
-    
-    pplx::task<json::value> make_api_call(const std::string& endpoint, const std::string& method) {
-        http_client client(utility::conversions::to_string_t(api_base), client_config);
-        auto request = create_request(endpoint, method);
 
-        return client.request(request)
-            .then([](http_response response) {
+    static json::value http_error(const http_response& response) {
+        json::value error_obj;
+        error_obj[U("error")] = json::value::string(
+            U("HTTP Error: ") + utility::conversions::to_string_t(std::to_string(response.status_code())));
+        error_obj[U("success")] = json::value::boolean(false);
+        return error_obj;
+    }
+
+    // Sends one request through admission control: waits for a concurrency
+    // slot and a rate token, and retries 429/503 responses after Retry-After
+    // or a jittered exponential backoff. decorate may add headers and is
+    // applied to every attempt. token cancels the attempt in flight and
+    // ends the wait for admission or a retry backoff right away. Queue and time-to-first-byte are recorded on
+    // trace; the caller finishes it. Only context is used after the first
+    // suspension, never this.
+    static pplx::task<http_response> send_request(const RequestContext& context, std::shared_ptr<RequestTrace> trace,
+                                                  const std::string& endpoint, const std::string& method,
+                                                  const pplx::cancellation_token& token,
+                                                  const RequestDecorator& decorate = nullptr, int attempt = 0) {
+        auto controller = context.admission;
+        std::string path = endpoint;
+
+        return controller->acquire(token).then([context, trace, controller, path, method, token, decorate, attempt](uint64_t ticket) {
+            trace->mark(Phase::Queue);
+            auto request = create_request(context.host, path, method);
+            if (decorate) decorate(request);
+            trace->sent(request_size(request, path, method));
+
+            return context.transport->send(request, token).then([context, trace, controller, ticket, path, method, token, decorate, attempt](pplx::task<http_response> previousTask) {
+                http_response response;
+                try {
+                    response = previousTask.get();
+                } catch (...) {
+                    trace->failed();
+                    controller->release(AdmissionController::Outcome::Failed, ticket);
+                    throw;
+                }
+                trace->mark(Phase::TimeToFirstByte);
+                trace->status(response.status_code());
+
+                bool overloaded = response.status_code() == status_codes::TooManyRequests ||
+                                  response.status_code() == status_codes::ServiceUnavailable;
+                controller->release(overloaded ? AdmissionController::Outcome::Overloaded : AdmissionController::Outcome::Success, ticket);
+                if (!overloaded) return pplx::task_from_result(response);
+
+                std::string retry_after;
+                auto header = response.headers().find(U("Retry-After"));
+                if (header != response.headers().end()) retry_after = utility::conversions::to_utf8string(header->second);
+                auto delay = controller->retry_delay(attempt, retry_after);
+                if (delay.count() < 0 || token.is_canceled()) return pplx::task_from_result(response);
+
+                trace->retried();
+                return context.timers->delay(delay, token).then([context, trace, path, method, token, decorate, attempt]() {
+                    return send_request(context, trace, path, method, token, decorate, attempt + 1);
+                });
+            });
+        });
+    }
+
+    // Cancellation for a call starting now: the current ScopedCallOptions
+    // token, linked to a TimerQueue deadline when a timeout is set. The
+    // caller calls finished() once the call is over, which removes the
+    // deadline so the timer queue does not grow with every timed call.
+    struct CallToken {
+        pplx::cancellation_token token = pplx::cancellation_token::none();
+        std::shared_ptr<TimerQueue> timers;
+        TimerQueue::TimerId deadline;
+
+        void finished() const {
+            if (timers) timers->cancel(deadline);
+        }
+    };
+
+    CallToken call_token() {
+        CallToken call;
+        const CallOptions* options = ScopedCallOptions::current();
+        if (!options) return call;
+        call.token = options->token;
+        if (options->timeout.count() <= 0) return call;
+
+        auto source = options->token.is_cancelable()
+            ? pplx::cancellation_token_source::create_linked_source(options->token)
+            : pplx::cancellation_token_source();
+        call.token = source.get_token();
+        call.timers = timer_queue;
+        call.deadline = timer_queue->schedule_after(options->timeout, [source]() { source.cancel(); });
+        return call;
+    }
+
+    // Reads and parses a 200 response body, recording body and parse time.
+    static pplx::task<json::value> extract_traced_json(http_response response, std::shared_ptr<RequestTrace> trace) {
+        return response.extract_string().then([trace](utility::string_t body) {
+            trace->mark(Phase::Body);
+            trace->received(body.size() * sizeof(utility::char_t));
+            auto value = json::value::parse(body);
+            trace->mark(Phase::Parse);
+            return value;
+        });
+    }
+
+    // Plain request used by the response cache: adds the stale entry's
+    // validators and reports 304s instead of turning them into errors.
+    pplx::task<ResponseCache::Fetched> fetch_for_cache(Endpoint id, const std::string& endpoint, const std::string& method,
+                                                       const std::string& etag, const std::string& last_modified) {
+        auto trace = std::make_shared<RequestTrace>(request_metrics, id, endpoint);
+        auto add_validators = [etag, last_modified](http_request& request) {
+            if (!etag.empty()) request.headers().add(U("If-None-Match"), utility::conversions::to_string_t(etag));
+            if (!last_modified.empty()) request.headers().add(U("If-Modified-Since"), utility::conversions::to_string_t(last_modified));
+        };
+
+        return send_request(request_context(), trace, endpoint, method, pplx::cancellation_token::none(), add_validators)
+            .then([trace](http_response response) {
+                ResponseCache::Fetched fetched;
+                if (response.status_code() == status_codes::NotModified) {
+                    fetched.not_modified = true;
+                    trace->finish();
+                    return pplx::task_from_result(fetched);
+                }
+                if (response.status_code() != status_codes::OK) {
+                    fetched.body = http_error(response);
+                    trace->finish("HTTP Error");
+                    return pplx::task_from_result(fetched);
+                }
+
+                auto etag_header = response.headers().find(U("ETag"));
+                if (etag_header != response.headers().end()) fetched.etag = utility::conversions::to_utf8string(etag_header->second);
+                auto modified_header = response.headers().find(U("Last-Modified"));
+                if (modified_header != response.headers().end()) fetched.last_modified = utility::conversions::to_utf8string(modified_header->second);
+
+                return response.extract_string().then([fetched, trace](utility::string_t body) mutable {
+                    trace->mark(Phase::Body);
+                    trace->received(body.size() * sizeof(utility::char_t));
+                    fetched.body = json::value::parse(body);
+                    trace->mark(Phase::Parse);
+                    fetched.bytes = ResponseCache::estimated_size(fetched.body);
+                    fetched.cacheable = true;
+                    trace->finish();
+                    return fetched;
+                });
+            })
+            .then([trace](pplx::task<ResponseCache::Fetched> previousTask) {
+                try {
+                    return previousTask.get();
+                } catch (const std::exception& e) {
+                    trace->finish(e.what());
+                    throw;
+                }
+            });
+    }
+
+    pplx::task<json::value> make_api_call(Endpoint id, const std::string& endpoint, const std::string& method) {
+        auto ttl = std::chrono::milliseconds(cache_ttl_ms[static_cast<size_t>(id)].load(std::memory_order_relaxed));
+        if (ttl.count() > 0 && method == "GET") {
+            return response_cache->get(endpoint, ttl, [this, id, endpoint, method](const std::string& etag, const std::string& last_modified) {
+                return fetch_for_cache(id, endpoint, method, etag, last_modified);
+            });
+        }
+
+        auto trace = std::make_shared<RequestTrace>(request_metrics, id, endpoint);
+        auto call = call_token();
+        return send_request(request_context(), trace, endpoint, method, call.token)
+            .then([trace](http_response response) {
                 if (response.status_code() == status_codes::OK) {
-                    return response.extract_json();
+                    return extract_traced_json(response, trace);
                 } else {
+                    return pplx::task_from_result(http_error(response));
+                }
+            })
+            .then([trace, call](pplx::task<json::value> previousTask) {
+                call.finished();
+                try {
+                    auto result = previousTask.get();
+                    trace->finish(result.has_field(U("error")) ? "HTTP Error" : "");
+                    return result;
+                } catch (const std::exception& e) {
+                    trace->finish(e.what());
                     json::value error_obj;
                     error_obj[U("error")] = json::value::string(
-                        U("HTTP Error: ") + utility::conversions::to_string_t(std::to_string(response.status_code())));
+                        U("Exception: ") + utility::conversions::to_string_t(e.what()));
                     error_obj[U("success")] = json::value::boolean(false);
-                    return pplx::task_from_result(error_obj);
+                    return error_obj;
+                }
+            });
+    }
+
+    static pplx::task<void> read_body_chunks(concurrency::streams::streambuf<uint8_t> body,
+                                             std::shared_ptr<std::vector<uint8_t>> buffer,
+                                             std::shared_ptr<JsonRecordSplitter> splitter,
+                                             std::shared_ptr<RequestTrace> trace) {
+        return body.getn(buffer->data(), buffer->size()).then([body, buffer, splitter, trace](size_t read) {
+            if (read == 0) return pplx::task_from_result();
+            trace->received(read);
+            splitter->feed(reinterpret_cast<const char*>(buffer->data()), read);
+            return read_body_chunks(body, buffer, splitter, trace);
+        });
+    }
+
+    // Streaming counterpart of make_api_call: the body is scanned chunk by chunk
+    // as it arrives and each element of its "data" array is passed to on_record
+    // as raw JSON text. Resolves to {"records": n} or the usual error object.
+    // Decoding overlaps the transfer, so its time is reported as body time.
+    pplx::task<json::value> stream_api_call(Endpoint id, const std::string& endpoint, const std::string& method,
+                                            const JsonRecordSplitter::RecordCallback& on_record) {
+        auto trace = std::make_shared<RequestTrace>(request_metrics, id, endpoint);
+        auto call = call_token();
+        return send_request(request_context(), trace, endpoint, method, call.token)
+            .then([on_record, trace](http_response response) {
+                if (response.status_code() == status_codes::OK) {
+                    auto splitter = std::make_shared<JsonRecordSplitter>(on_record);
+                    auto buffer = std::make_shared<std::vector<uint8_t>>(64 * 1024);
+                    return read_body_chunks(response.body().streambuf(), buffer, splitter, trace).then([splitter, trace]() {
+                        trace->mark(Phase::Body);
+                        json::value summary;
+                        summary[U("records")] = json::value::number(static_cast<int64_t>(splitter->record_count()));
+                        return summary;
+                    });
+                } else {
+                    return pplx::task_from_result(http_error(response));
                 }
             })
-            .then([](pplx::task<json::value> previousTask) {
+            .then([trace, call](pplx::task<json::value> previousTask) {
+                call.finished();
                 try {
-                    return previousTask.get();
+                    auto result = previousTask.get();
+                    trace->finish(result.has_field(U("error")) ? "HTTP Error" : "");
+                    return result;
                 } catch (const std::exception& e) {
+                    trace->finish(e.what());
                     json::value error_obj;
                     error_obj[U("error")] = json::value::string(
                         U("Exception: ") + utility::conversions::to_string_t(e.what()));
@@ -86,23 +353,161 @@ private:
             });
     }
 
+    // Streams the response straight into columns without building a DOM.
+    pplx::task<MeasurementColumns> fetch_columns(Endpoint id, const std::string& endpoint) {
+        auto columns = std::make_shared<MeasurementColumns>();
+        return stream_api_call(id, endpoint, "GET", [columns](const char* record, size_t length) {
+                columns->append_record(record, length);
+            })
+            .then([columns](json::value summary) {
+                if (summary.has_field(U("error"))) {
+                    columns->error = utility::conversions::to_utf8string(summary.at(U("error")).as_string());
+                }
+                return std::move(*columns);
+            });
+    }
+
+    // One pushed-down bucket: the API groups [from_ms, to_ms) by station.
+    pplx::task<AggregateRows> fetch_aggregate_rows(const std::string& stationTypes, const std::string& dataType,
+                                                   int64_t from_ms, int64_t to_ms, const std::string& where) {
+        auto rows = std::make_shared<AggregateRows>();
+        return stream_api_call(Endpoint::HistoricalMeasurements, historical_measurements_path(
+                "flat,node", stationTypes, dataType, format_timestamp(from_ms), format_timestamp(to_ms),
+                -1, 0, aggregate_select(), where, false, true, "UTC", ""), "GET",
+            [rows](const char* record, size_t length) {
+                AggregateRow row;
+                if (parse_aggregate_row(record, length, row)) {
+                    rows->rows.push_back(row);
+                } else {
+                    rows->complete = false;
+                }
+            })
+            .then([rows](json::value summary) {
+                if (summary.has_field(U("error"))) {
+                    rows->error = utility::conversions::to_utf8string(summary.at(U("error")).as_string());
+                }
+                return std::move(*rows);
+            });
+    }
+
+    pplx::task<Aggregates> aggregate_locally(const std::string& stationTypes, const std::string& dataType,
+                                             int64_t from_ms, int64_t to_ms, int64_t bucket_ms, const std::string& where) {
+        return get_historical_measurement_columns("flat,node", stationTypes, dataType,
+                format_timestamp(from_ms), format_timestamp(to_ms), -1, 0, "", where)
+            .then([from_ms, to_ms, bucket_ms](MeasurementColumns columns) {
+                Aggregates result(from_ms, to_ms, bucket_ms);
+                result.error = columns.error;
+                if (result.error.empty()) aggregate_columns(columns, result);
+                return result;
+            });
+    }
+
+    // Per-thread builder whose buffer is reused for every request. The
+    // returned path stays valid until the next request is built on this thread.
+    static RequestBuilder& request_builder() {
+        static thread_local RequestBuilder builder;
+        return builder.reset();
+    }
+
+    static const std::string& latest_measurements_path(
+        const std::string& representation, const std::string& stationTypes, const std::string& dataTypes,
+        int limit, int offset, const std::string& select, const std::string& where,
+        bool shownull, bool distinct, const std::string& timezone, const std::string& origin) {
+        
+        auto& builder = request_builder().segment(representation).segment(stationTypes).segment(dataTypes).path("/latest")
+            .query(limit, offset, select, where, shownull, distinct);
+        if (timezone != "UTC") builder.param("timezone", timezone);
+        return builder.param("origin", origin).str();
+    }
+
+    static const std::string& historical_measurements_path(
+        const std::string& representation, const std::string& stationTypes, const std::string& dataTypes,
+        const std::string& from, const std::string& to,
+        int limit, int offset, const std::string& select, const std::string& where,
+        bool shownull, bool distinct, const std::string& timezone, const std::string& origin) {
+        
+        auto& builder = request_builder().segment(representation).segment(stationTypes).segment(dataTypes).segment(from).segment(to)
+            .query(limit, offset, select, where, shownull, distinct);
+        if (timezone != "UTC") builder.param("timezone", timezone);
+        return builder.param("origin", origin).str();
+    }
+
 public:
-    OpenDataHubAPI() {
-        client_config.set_validate_certificates(false);
+    typedef std::function<void(const json::value& record)> RecordSink;
+
+    // pool_size is the number of persistent http_client instances shared by
+    // all calls; 0 falls back to a new client (and connection) per request.
+    // base selects another deployment, e.g. a local ReplayServer.
+    explicit OpenDataHubAPI(size_t pool_size = 4, const std::string& base = DEFAULT_API_BASE)
+        : OpenDataHubAPI(std::make_shared<HttpTransport>(base, default_client_config(), pool_size), base) {}
+
+    // Sends every request through transport, e.g. a RecordingTransport.
+    // Request URIs are relative to base, which also sets the Host header.
+    explicit OpenDataHubAPI(std::shared_ptr<Transport> transport, const std::string& base = DEFAULT_API_BASE)
+        : api_base(base), transport(std::move(transport)) {
+        web::uri base_uri(utility::conversions::to_string_t(api_base));
+        host_header = base_uri.host();
+        if (!base_uri.is_port_default()) {
+            host_header += U(":") + utility::conversions::to_string_t(std::to_string(base_uri.port()));
+        }
+        response_cache = std::make_shared<ResponseCache>();
+        timer_queue = std::make_shared<TimerQueue>();
+        request_metrics = std::make_shared<Metrics>();
+        aggregate_pushdown = true;
+        admission = std::make_shared<AdmissionController>(AdmissionOptions(), timer_queue);
+        for (auto& ttl : cache_ttl_ms) ttl.store(0);
+        set_cache_ttl(Endpoint::EntryPoints, std::chrono::minutes(5));
+        set_cache_ttl(Endpoint::Categories, std::chrono::minutes(5));
+        set_cache_ttl(Endpoint::Stations, std::chrono::minutes(5));
+        set_cache_ttl(Endpoint::StationsWithDataTypes, std::chrono::minutes(5));
     }
 
+    // How long successful responses of an endpoint are served from the cache;
+    // zero disables caching for it. Only the four metadata endpoints are
+    // cached by default.
+    void set_cache_ttl(Endpoint endpoint, std::chrono::milliseconds ttl) {
+        cache_ttl_ms[static_cast<size_t>(endpoint)].store(ttl.count());
+    }
+
+    // Replaces the rate limit, concurrency window and retry policy. Requests
+    // already admitted finish under the previous settings.
+    void set_admission_options(const AdmissionOptions& options) {
+        std::atomic_store(&admission, std::make_shared<AdmissionController>(options, timer_queue));
+    }
+
+    // Current AIMD cap on requests in flight.
+    double concurrency_limit() const { return std::atomic_load(&admission)->current_concurrency_limit(); }
+
+    // Per-endpoint latency histograms, byte and status counters and the
+    // in-flight gauge. Cache hits are not counted as requests.
+    const EndpointMetrics& endpoint_metrics(Endpoint endpoint) const { return request_metrics->endpoint(endpoint); }
+
+    // All metrics in Prometheus text exposition format.
+    std::string metrics_prometheus() const { return request_metrics->prometheus(); }
+
+    // Called with a Span for every finished request, on the thread that
+    // finished it; pass nullptr to remove.
+    void set_trace_hook(const Metrics::TraceHook& hook) { request_metrics->set_trace_hook(hook); }
+
+    // Upper bound on the combined size of cached response bodies.
+    void set_cache_capacity(size_t bytes) { response_cache->set_capacity(bytes); }
+
+    void clear_cache() { response_cache->clear(); }
+
+    // Clients in the HttpTransport pool; 0 for other transports.
+    size_t pool_size() const {
+        auto http = dynamic_cast<const HttpTransport*>(transport.get());
+        return http ? http->pool_size() : 0;
+    }
+
+    const std::string& base() const { return api_base; }
+
     pplx::task<json::value> get_entry_points(const std::string& origin = "") {
-        std::map<std::string, std::string> params;
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + build_query_params(params), "GET");
+        return make_api_call(Endpoint::EntryPoints, request_builder().path("/").param("origin", origin).str(), "GET");
     }
 
     pplx::task<json::value> get_categories(const std::string& representation = "flat,node", const std::string& origin = "") {
-        std::map<std::string, std::string> params;
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + build_query_params(params), "GET");
+        return make_api_call(Endpoint::Categories, request_builder().segment(representation).param("origin", origin).str(), "GET");
     }
 
     pplx::task<json::value> get_stations(
@@ -116,16 +521,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(stationTypes))) + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(stationTypes)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::Stations, builder.str(), "GET");
     }
 
     pplx::task<json::value> get_edges(
@@ -139,16 +537,56 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
+        auto& builder = request_builder().segment(representation).segment(edgeTypes)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::Edges, builder.str(), "GET");
+    }
+
+    // Fetches every page of get_stations, keeping up to max_in_flight page
+    // requests outstanding, and returns them merged into a single "data" array.
+    // The current CallOptions apply to the whole walk: every page gets the
+    // token, and the timeout is one deadline for all pages together.
+    pplx::task<json::value> fetch_all_stations(
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        int page_size = 200,
+        int max_in_flight = 4,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& origin = "") {
+        
+        auto call = call_token();
+        return Paginator::merge([this, representation, stationTypes, page_size, select, where, shownull, distinct, origin](int offset) {
+            return get_stations(representation, stationTypes, page_size, offset, select, where, shownull, distinct, origin);
+        }, page_size, max_in_flight, call.token).then([call](json::value result) {
+            call.finished();
+            return result;
+        });
+    }
+
+    // Like fetch_all_stations, but hands each page to on_page in offset order
+    // instead of accumulating them.
+    pplx::task<json::value> for_each_stations_page(
+        const Paginator::PageCallback& on_page,
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        int page_size = 200,
+        int max_in_flight = 4,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& origin = "") {
         
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(edgeTypes))) + build_query_params(params), "GET");
+        auto call = call_token();
+        return Paginator::run([this, representation, stationTypes, page_size, select, where, shownull, distinct, origin](int offset) {
+            return get_stations(representation, stationTypes, page_size, offset, select, where, shownull, distinct, origin);
+        }, on_page, page_size, max_in_flight, call.token).then([call](json::value result) {
+            call.finished();
+            return result;
+        });
     }
 
     pplx::task<json::value> get_stations_with_data_types(
@@ -163,16 +601,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(stationTypes))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(dataTypes))) + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(stationTypes).segment(dataTypes)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::StationsWithDataTypes, builder.str(), "GET");
     }
 
     pplx::task<json::value> get_latest_measurements(
@@ -188,17 +619,8 @@ public:
         const std::string& timezone = "UTC",
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (timezone != "UTC") params["timezone"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(timezone)));
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(stationTypes))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(dataTypes))) + "/latest" + build_query_params(params), "GET");
+        return make_api_call(Endpoint::LatestMeasurements, latest_measurements_path(
+            representation, stationTypes, dataTypes, limit, offset, select, where, shownull, distinct, timezone, origin), "GET");
     }
 
     pplx::task<json::value> get_historical_measurements(
@@ -216,22 +638,72 @@ public:
         const std::string& timezone = "UTC",
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (timezone != "UTC") params["timezone"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(timezone)));
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
+        return make_api_call(Endpoint::HistoricalMeasurements, historical_measurements_path(
+            representation, stationTypes, dataTypes, from, to, limit, offset, select, where, shownull, distinct, timezone, origin), "GET");
+    }
+
+    // Fetches every page of get_historical_measurements, keeping up to
+    // max_in_flight page requests outstanding, and returns them merged into a
+    // single "data" array.
+    pplx::task<json::value> fetch_all_historical_measurements(
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
+        const std::string& from = "",
+        const std::string& to = "",
+        int page_size = 200,
+        int max_in_flight = 4,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& timezone = "UTC",
+        const std::string& origin = "") {
         
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(stationTypes))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(dataTypes))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(from))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(to))) + build_query_params(params), "GET");
+        auto call = call_token();
+        return Paginator::merge([this, representation, stationTypes, dataTypes, from, to, page_size, select, where, shownull, distinct, timezone, origin](int offset) {
+            return get_historical_measurements(representation, stationTypes, dataTypes, from, to, page_size, offset, select, where, shownull, distinct, timezone, origin);
+        }, page_size, max_in_flight, call.token).then([call](json::value result) {
+            call.finished();
+            return result;
+        });
     }
 
-    pplx::task<json::value> get_metadata_history(
+    // Like fetch_all_historical_measurements, but hands each page to on_page
+    // in offset order instead of accumulating them.
+    pplx::task<json::value> for_each_historical_measurements_page(
+        const Paginator::PageCallback& on_page,
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
+        const std::string& from = "",
+        const std::string& to = "",
+        int page_size = 200,
+        int max_in_flight = 4,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& timezone = "UTC",
+        const std::string& origin = "") {
+        
+        auto call = call_token();
+        return Paginator::run([this, representation, stationTypes, dataTypes, from, to, page_size, select, where, shownull, distinct, timezone, origin](int offset) {
+            return get_historical_measurements(representation, stationTypes, dataTypes, from, to, page_size, offset, select, where, shownull, distinct, timezone, origin);
+        }, on_page, page_size, max_in_flight, call.token).then([call](json::value result) {
+            call.finished();
+            return result;
+        });
+    }
+
+    // Same query as get_historical_measurements, but the response is parsed
+    // incrementally and each record of "data" is passed to sink as soon as it
+    // has arrived, so memory use does not grow with limit.
+    pplx::task<json::value> stream_historical_measurements(
+        const RecordSink& sink,
         const std::string& representation = "flat,node",
         const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
         const std::string& from = "",
         const std::string& to = "",
         int limit = 200,
@@ -243,17 +715,231 @@ public:
         const std::string& timezone = "UTC",
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (timezone != "UTC") params["timezone"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(timezone)));
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
+        return stream_api_call(Endpoint::HistoricalMeasurements, historical_measurements_path(
+                representation, stationTypes, dataTypes, from, to, limit, offset, select, where, shownull, distinct, timezone, origin), "GET",
+            [sink](const char* record, size_t length) {
+                sink(json::value::parse(utility::conversions::to_string_t(std::string(record, length))));
+            });
+    }
+
+    // Same query as get_latest_measurements, decoded into a MeasurementColumns
+    // batch. Requires a flat representation; select must keep mvalidtime,
+    // mvalue, scode and tname.
+    pplx::task<MeasurementColumns> get_latest_measurement_columns(
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
+        int limit = 200,
+        int offset = 0,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& timezone = "UTC",
+        const std::string& origin = "") {
         
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(stationTypes))) + "/metadata/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(from))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(to))) + build_query_params(params), "GET");
+        return fetch_columns(Endpoint::LatestMeasurements, latest_measurements_path(
+            representation, stationTypes, dataTypes, limit, offset, select, where, shownull, distinct, timezone, origin));
+    }
+
+    // Same query as get_historical_measurements, decoded into a
+    // MeasurementColumns batch. Requires a flat representation; select must
+    // keep mvalidtime, mvalue, scode and tname.
+    pplx::task<MeasurementColumns> get_historical_measurement_columns(
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
+        const std::string& from = "",
+        const std::string& to = "",
+        int limit = 200,
+        int offset = 0,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& timezone = "UTC",
+        const std::string& origin = "") {
+        
+        return fetch_columns(Endpoint::HistoricalMeasurements, historical_measurements_path(
+            representation, stationTypes, dataTypes, from, to, limit, offset, select, where, shownull, distinct, timezone, origin));
+    }
+
+#ifndef _WIN32
+    // One (station, data type, period) series over [from_ms, to_ms), served
+    // from store where possible. period is the mperiod in seconds; the fetch
+    // is filtered on it, since a station may report a type at several
+    // periods with overlapping timestamps. Only the intervals the store has
+    // never seen are fetched from the API, and what comes back is appended
+    // to the store. Data newer than now - settle is returned but not stored,
+    // because it may still change upstream.
+    pplx::task<MeasurementColumns> get_historical_series(
+        TimeSeriesStore& store,
+        const std::string& stationType,
+        const std::string& stationCode,
+        const std::string& dataType,
+        int period,
+        int64_t from_ms,
+        int64_t to_ms,
+        std::chrono::milliseconds settle = std::chrono::hours(1)) {
+        
+        auto gaps = store.missing(stationCode, dataType, period, from_ms, to_ms);
+        std::string where = "and(scode.eq." + quote_where_value(stationCode) + ",mperiod.eq." + std::to_string(period) + ")";
+        std::vector<pplx::task<MeasurementColumns>> fetches;
+        for (const auto& gap : gaps) {
+            fetches.push_back(get_historical_measurement_columns("flat,node", stationType, dataType,
+                format_timestamp(gap.first), format_timestamp(gap.second), -1, 0, "", where));
+        }
+        auto fetched = fetches.empty() ? pplx::task_from_result(std::vector<MeasurementColumns>())
+                                       : pplx::when_all(fetches.begin(), fetches.end());
+        int64_t settled = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch() - settle).count();
+        TimeSeriesStore* series_store = &store;
+
+        return fetched.then([series_store, gaps, stationCode, dataType, period, from_ms, to_ms, settled](std::vector<MeasurementColumns> results) {
+            MeasurementColumns columns;
+            std::vector<TimeSeriesStore::Point> unsettled;
+            try {
+                for (size_t i = 0; i < results.size(); ++i) {
+                    if (!results[i].error.empty()) {
+                        columns.error = results[i].error;
+                        return columns;
+                    }
+                    std::vector<TimeSeriesStore::Point> points;
+                    for (size_t row = 0; row < results[i].size(); ++row) {
+                        TimeSeriesStore::Point point = { results[i].timestamps[row], results[i].values[row] };
+                        points.push_back(point);
+                        if (point.timestamp >= settled) unsettled.push_back(point);
+                    }
+                    series_store->append(stationCode, dataType, period, points,
+                                         TimeSeriesStore::Interval(gaps[i].first, std::min(gaps[i].second, settled)));
+                }
+
+                // Stored points all precede settled, so the unsettled ones go after them.
+                uint32_t station_id = columns.stations.intern(stationCode);
+                uint32_t type_id = columns.types.intern(dataType);
+                series_store->scan(stationCode, dataType, period, from_ms, std::min(to_ms, settled),
+                    [&columns, station_id, type_id](const int64_t* timestamps, const double* values, size_t count) {
+                        columns.timestamps.insert(columns.timestamps.end(), timestamps, timestamps + count);
+                        columns.values.insert(columns.values.end(), values, values + count);
+                        columns.station_ids.insert(columns.station_ids.end(), count, station_id);
+                        columns.type_ids.insert(columns.type_ids.end(), count, type_id);
+                    });
+
+                std::stable_sort(unsettled.begin(), unsettled.end(), [](const TimeSeriesStore::Point& a, const TimeSeriesStore::Point& b) {
+                    return a.timestamp < b.timestamp;
+                });
+                for (const auto& point : unsettled) columns.push_back(point.timestamp, point.value, station_id, type_id);
+            } catch (const std::exception& e) {
+                columns = MeasurementColumns();
+                columns.error = std::string("Exception: ") + e.what();
+            }
+            return columns;
+        });
+    }
+#endif
+
+    // min/max/sum/count of dataType per station and bucket over
+    // [from_ms, to_ms). Up to options.max_pushdown_buckets buckets are
+    // computed by the API with one aggregate select per bucket, issued
+    // concurrently. Longer ranges fetch the rows as columns and reduce them
+    // locally. So does every query once the API has answered an aggregate
+    // select with plain rows. A 400 only sends the current query down the
+    // local path, since a bad where would cause it as well; that query then
+    // returns the 400 again if the filter is at fault.
+    pplx::task<Aggregates> aggregate_historical_measurements(
+        const std::string& stationTypes,
+        const std::string& dataType,
+        int64_t from_ms,
+        int64_t to_ms,
+        std::chrono::milliseconds bucket,
+        const AggregateOptions& options = AggregateOptions()) {
+        
+        Aggregates shape(from_ms, to_ms, bucket.count());
+        std::string where = options.where;
+        int64_t bucket_ms = bucket.count();
+        if (shape.bucket_count == 0 || shape.bucket_count > options.max_pushdown_buckets || !aggregate_pushdown.load()) {
+            return aggregate_locally(stationTypes, dataType, from_ms, to_ms, bucket_ms, where);
+        }
+
+        std::vector<pplx::task<AggregateRows>> fetches;
+        for (size_t b = 0; b < shape.bucket_count; ++b) {
+            fetches.push_back(fetch_aggregate_rows(stationTypes, dataType, shape.bucket_start(b),
+                                                   std::min(shape.bucket_start(b + 1), to_ms), where));
+        }
+
+        return pplx::when_all(fetches.begin(), fetches.end())
+            .then([this, shape, stationTypes, dataType, from_ms, to_ms, bucket_ms, where](std::vector<AggregateRows> buckets) {
+                Aggregates result = shape;
+                result.pushed_down = true;
+                for (size_t b = 0; b < buckets.size(); ++b) {
+                    if (!buckets[b].complete) {
+                        aggregate_pushdown = false;
+                        return aggregate_locally(stationTypes, dataType, from_ms, to_ms, bucket_ms, where);
+                    }
+                    if (buckets[b].error == "HTTP Error: 400") {
+                        return aggregate_locally(stationTypes, dataType, from_ms, to_ms, bucket_ms, where);
+                    }
+                    if (!buckets[b].error.empty()) {
+                        result.error = buckets[b].error;
+                        return pplx::task_from_result(result);
+                    }
+                    for (const auto& row : buckets[b].rows) {
+                        result.merge(result.cell(result.add_station(row.station), b), row.min, row.max, row.sum, row.count);
+                    }
+                }
+                return pplx::task_from_result(result);
+            });
+    }
+
+    // Returns a batch whose queries are answered by merged
+    // get_latest_measurements calls once flush() is called.
+    std::shared_ptr<LatestMeasurementsBatch> latest_measurements_batch(size_t max_queries_per_call = 50) {
+        return std::make_shared<LatestMeasurementsBatch>(
+            [this](const std::string& stationTypes, const std::string& dataTypes, const std::string& where) {
+                return get_latest_measurements("flat,node", stationTypes, dataTypes, -1, 0, "", where);
+            }, max_queries_per_call);
+    }
+
+    // Polls latest measurements and calls on_delta with only the rows whose
+    // mvalidtime advanced since the previous poll, per (station, data type).
+    // The first poll delivers the full snapshot. Later polls add a
+    // "mvalidtime.gt." filter so unchanged series are not downloaded again.
+    std::shared_ptr<MeasurementTail> tail_latest_measurements(
+        const MeasurementTail::DeltaCallback& on_delta,
+        const std::string& stationTypes = "*",
+        const std::string& dataTypes = "*",
+        const std::string& where = "",
+        const TailOptions& options = TailOptions(),
+        const MeasurementTail::ErrorCallback& on_error = nullptr) {
+        
+        auto poll = [this, stationTypes, dataTypes, where](const std::string& since) {
+            std::string filter = where;
+            if (!since.empty()) filter = where.empty() ? since : "and(" + where + "," + since + ")";
+            return get_latest_measurement_columns("flat,node", stationTypes, dataTypes, -1, 0, "", filter);
+        };
+        auto tail = std::make_shared<MeasurementTail>(poll, on_delta, on_error, options, timer_queue);
+        tail->start();
+        return tail;
+    }
+
+    pplx::task<json::value> get_metadata_history(
+        const std::string& representation = "flat,node",
+        const std::string& stationTypes = "*",
+        const std::string& from = "",
+        const std::string& to = "",
+        int limit = 200,
+        int offset = 0,
+        const std::string& select = "",
+        const std::string& where = "",
+        bool shownull = false,
+        bool distinct = true,
+        const std::string& timezone = "UTC",
+        const std::string& origin = "") {
+        
+        auto& builder = request_builder().segment(representation).segment(stationTypes).path("/metadata").segment(from).segment(to)
+            .query(limit, offset, select, where, shownull, distinct);
+        if (timezone != "UTC") builder.param("timezone", timezone);
+        return make_api_call(Endpoint::MetadataHistory, builder.param("origin", origin).str(), "GET");
     }
 
     pplx::task<json::value> get_events(
@@ -267,16 +953,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(eventorigins))) + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(eventorigins)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::Events, builder.str(), "GET");
     }
 
     pplx::task<json::value> get_latest_events(
@@ -290,16 +969,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(eventorigins))) + "/latest" + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(eventorigins).path("/latest")
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::LatestEvents, builder.str(), "GET");
     }
 
     pplx::task<json::value> get_events_at_timepoint(
@@ -314,16 +986,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(eventorigins))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(timepoint))) + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(eventorigins).segment(timepoint)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::EventsAtTimepoint, builder.str(), "GET");
     }
 
     pplx::task<json::value> get_events_in_interval(
@@ -339,16 +1004,9 @@ public:
         bool distinct = true,
         const std::string& origin = "") {
         
-        std::map<std::string, std::string> params;
-        if (limit != 200) params["limit"] = std::to_string(limit);
-        if (offset != 0) params["offset"] = std::to_string(offset);
-        if (!select.empty()) params["select"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(select)));
-        if (!where.empty()) params["where"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(where)));
-        if (shownull) params["shownull"] = "true";
-        if (!distinct) params["distinct"] = "false";
-        if (!origin.empty()) params["origin"] = utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(origin)));
-        
-        return make_api_call("/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(representation))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(eventorigins))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(from))) + "/" + utility::conversions::to_utf8string(web::uri::encode_data_string(utility::conversions::to_string_t(to))) + build_query_params(params), "GET");
+        auto& builder = request_builder().segment(representation).segment(eventorigins).segment(from).segment(to)
+            .query(limit, offset, select, where, shownull, distinct).param("origin", origin);
+        return make_api_call(Endpoint::EventsInInterval, builder.str(), "GET");
     }
 };
 
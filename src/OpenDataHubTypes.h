@@ -0,0 +1,144 @@
+#ifndef OPEN_DATA_HUB_TYPES_H
+#define OPEN_DATA_HUB_TYPES_H
+
+#include <cpprest/json.h>
+#include "MeasurementColumns.h"
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Typed views of the flat representation records. Missing fields are left
+// at their defaults.
+struct Station {
+    std::string code;
+    std::string name;
+    std::string type;
+    std::string origin;
+    bool active = false;
+    double latitude = std::numeric_limits<double>::quiet_NaN();
+    double longitude = std::numeric_limits<double>::quiet_NaN();
+};
+
+struct DataType {
+    std::string name;
+    std::string unit;
+    std::string description;
+    std::string type;
+};
+
+struct Measurement {
+    std::string station_code;
+    std::string data_type;
+    int64_t timestamp_ms = 0;
+    double value = std::numeric_limits<double>::quiet_NaN();
+    int period = 0;
+};
+
+struct Event {
+    std::string uuid;
+    std::string origin;
+    std::string category;
+    std::string name;
+    std::string description;
+    int64_t begin_ms = 0;
+    int64_t end_ms = 0;
+};
+
+namespace odh_detail {
+
+inline std::string string_field(const web::json::value& record, const utility::char_t* key) {
+    if (!record.has_field(key) || !record.at(key).is_string()) return "";
+    return utility::conversions::to_utf8string(record.at(key).as_string());
+}
+
+inline double number_field(const web::json::value& record, const utility::char_t* key) {
+    if (!record.has_field(key) || !record.at(key).is_number()) return std::numeric_limits<double>::quiet_NaN();
+    return record.at(key).as_double();
+}
+
+inline int64_t time_field(const web::json::value& record, const utility::char_t* key) {
+    std::string text = string_field(record, key);
+    int64_t ms = 0;
+    parse_timestamp_ms(text.data(), text.size(), ms);
+    return ms;
+}
+
+template <typename T, typename F>
+inline std::vector<T> map_data(const web::json::value& response, F convert) {
+    std::vector<T> result;
+    if (!response.has_field(U("data")) || !response.at(U("data")).is_array()) return result;
+    const auto& data = response.at(U("data")).as_array();
+    result.reserve(data.size());
+    for (const auto& record : data) result.push_back(convert(record));
+    return result;
+}
+
+}
+
+inline Station station_from_json(const web::json::value& record) {
+    Station station;
+    station.code = odh_detail::string_field(record, U("scode"));
+    station.name = odh_detail::string_field(record, U("sname"));
+    station.type = odh_detail::string_field(record, U("stype"));
+    station.origin = odh_detail::string_field(record, U("sorigin"));
+    station.active = record.has_field(U("sactive")) && record.at(U("sactive")).is_boolean() && record.at(U("sactive")).as_bool();
+    if (record.has_field(U("scoordinate")) && record.at(U("scoordinate")).is_object()) {
+        const auto& coordinate = record.at(U("scoordinate"));
+        station.longitude = odh_detail::number_field(coordinate, U("x"));
+        station.latitude = odh_detail::number_field(coordinate, U("y"));
+    }
+    return station;
+}
+
+inline DataType data_type_from_json(const web::json::value& record) {
+    DataType type;
+    type.name = odh_detail::string_field(record, U("tname"));
+    type.unit = odh_detail::string_field(record, U("tunit"));
+    type.description = odh_detail::string_field(record, U("tdescription"));
+    type.type = odh_detail::string_field(record, U("ttype"));
+    return type;
+}
+
+inline Measurement measurement_from_json(const web::json::value& record) {
+    Measurement measurement;
+    measurement.station_code = odh_detail::string_field(record, U("scode"));
+    measurement.data_type = odh_detail::string_field(record, U("tname"));
+    measurement.timestamp_ms = odh_detail::time_field(record, U("mvalidtime"));
+    measurement.value = odh_detail::number_field(record, U("mvalue"));
+    double period = odh_detail::number_field(record, U("mperiod"));
+    measurement.period = std::isnan(period) ? 0 : static_cast<int>(period);
+    return measurement;
+}
+
+inline Event event_from_json(const web::json::value& record) {
+    Event event;
+    event.uuid = odh_detail::string_field(record, U("evuuid"));
+    event.origin = odh_detail::string_field(record, U("evorigin"));
+    event.category = odh_detail::string_field(record, U("evcategory"));
+    event.name = odh_detail::string_field(record, U("evname"));
+    event.description = odh_detail::string_field(record, U("evdescription"));
+    event.begin_ms = odh_detail::time_field(record, U("evstart"));
+    event.end_ms = odh_detail::time_field(record, U("evend"));
+    return event;
+}
+
+// Convert the "data" array of a flat representation response.
+inline std::vector<Station> parse_stations(const web::json::value& response) {
+    return odh_detail::map_data<Station>(response, station_from_json);
+}
+
+inline std::vector<DataType> parse_data_types(const web::json::value& response) {
+    return odh_detail::map_data<DataType>(response, data_type_from_json);
+}
+
+inline std::vector<Measurement> parse_measurements(const web::json::value& response) {
+    return odh_detail::map_data<Measurement>(response, measurement_from_json);
+}
+
+inline std::vector<Event> parse_events(const web::json::value& response) {
+    return odh_detail::map_data<Event>(response, event_from_json);
+}
+
+#endif
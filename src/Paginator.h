@@ -0,0 +1,178 @@
+#ifndef PAGINATOR_H
+#define PAGINATOR_H
+
+#include <cpprest/json.h>
+#include <pplx/pplx.h>
+#include "CallOptions.h"
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Walks a limit/offset endpoint by keeping up to max_in_flight page requests
+// outstanding at once. The first page shorter than page_size marks the end of
+// the data set; pages are handed to on_page strictly in offset order no
+// matter in which order the responses arrive. Requests never run more than
+// max_in_flight pages ahead of the next page to deliver, so a slow page
+// bounds how many finished ones wait for it. Only flat representations
+// (where "data" is an array) can be paged. Every page request is issued
+// with token current, and no page is started once it is canceled.
+class Paginator : public std::enable_shared_from_this<Paginator> {
+public:
+    typedef std::function<pplx::task<web::json::value>(int offset)> PageRequest;
+    typedef std::function<void(const web::json::value& page)> PageCallback;
+
+private:
+    PageRequest request_page;
+    PageCallback on_page;
+    int page_size;
+    int max_in_flight;
+    CallOptions page_options;
+
+    std::mutex state_mutex;
+    std::mutex delivery_mutex;
+    int next_page = 0;
+    int end_page = INT_MAX;
+    int next_delivery = 0;
+    int in_flight = 0;
+    size_t record_count = 0;
+    bool failed = false;
+    bool finished = false;
+    web::json::value error;
+    std::map<int, web::json::value> pending;
+    pplx::task_completion_event<web::json::value> done;
+
+    Paginator(const PageRequest& request, const PageCallback& callback, int size, int in_flight_limit,
+              const pplx::cancellation_token& token)
+        : request_page(request), on_page(callback), page_size(std::max(size, 1)), max_in_flight(std::max(in_flight_limit, 1)) {
+        page_options.token = token;
+    }
+
+    void launch_more() {
+        std::vector<int> pages;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            if (!failed && page_options.token.is_canceled()) {
+                failed = true;
+                error[U("error")] = web::json::value::string(U("Exception: canceled"));
+                error[U("success")] = web::json::value::boolean(false);
+            }
+            while (!failed && in_flight < max_in_flight && next_page < end_page && next_page < next_delivery + max_in_flight) {
+                pages.push_back(next_page++);
+                ++in_flight;
+            }
+        }
+
+        auto self = shared_from_this();
+        ScopedCallOptions scope(page_options);
+        for (int page : pages) {
+            request_page(page * page_size).then([self, page](pplx::task<web::json::value> previousTask) {
+                web::json::value result;
+                try {
+                    result = previousTask.get();
+                } catch (const std::exception& e) {
+                    result[U("error")] = web::json::value::string(
+                        U("Exception: ") + utility::conversions::to_string_t(e.what()));
+                    result[U("success")] = web::json::value::boolean(false);
+                }
+                self->page_completed(page, result);
+            });
+        }
+    }
+
+    void page_completed(int page, const web::json::value& result) {
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            --in_flight;
+            if (page >= end_page) {
+                // Speculative request past the last page; nothing to keep.
+            } else if (result.has_field(U("error"))) {
+                if (!failed) {
+                    failed = true;
+                    error = result;
+                }
+            } else if (!result.has_field(U("data")) || !result.at(U("data")).is_array()) {
+                if (!failed) {
+                    failed = true;
+                    error[U("error")] = web::json::value::string(U("Exception: page has no \"data\" array; use a flat representation"));
+                    error[U("success")] = web::json::value::boolean(false);
+                }
+            } else {
+                if (static_cast<int>(result.at(U("data")).size()) < page_size) end_page = page + 1;
+                pending[page] = result;
+            }
+        }
+
+        deliver();
+        launch_more();
+        finish_if_done();
+    }
+
+    void deliver() {
+        std::lock_guard<std::mutex> delivery_lock(delivery_mutex);
+        for (;;) {
+            web::json::value page;
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                auto it = pending.find(next_delivery);
+                if (failed || it == pending.end() || next_delivery >= end_page) break;
+                page = it->second;
+                pending.erase(it);
+                ++next_delivery;
+                record_count += page.at(U("data")).size();
+            }
+            if (on_page) on_page(page);
+        }
+    }
+
+    void finish_if_done() {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        if (finished || in_flight > 0) return;
+        if (!failed && next_delivery < end_page) return;
+
+        finished = true;
+        if (failed) {
+            done.set(error);
+        } else {
+            web::json::value summary;
+            summary[U("offset")] = web::json::value::number(0);
+            summary[U("limit")] = web::json::value::number(static_cast<int64_t>(record_count));
+            summary[U("pages")] = web::json::value::number(next_delivery);
+            done.set(summary);
+        }
+    }
+
+public:
+    // Resolves to {"offset", "limit", "pages"} describing what was delivered,
+    // or to the first {"error": ...} object returned by a page request.
+    static pplx::task<web::json::value> run(const PageRequest& request, const PageCallback& callback,
+                                            int page_size, int max_in_flight,
+                                            const pplx::cancellation_token& token = pplx::cancellation_token::none()) {
+        std::shared_ptr<Paginator> paginator(new Paginator(request, callback, page_size, max_in_flight, token));
+        auto result = pplx::create_task(paginator->done);
+        paginator->launch_more();
+        paginator->finish_if_done();
+        return result;
+    }
+
+    // Same walk, but concatenates every page's "data" into a single result
+    // shaped like one large page.
+    static pplx::task<web::json::value> merge(const PageRequest& request, int page_size, int max_in_flight,
+                                              const pplx::cancellation_token& token = pplx::cancellation_token::none()) {
+        auto records = std::make_shared<std::vector<web::json::value>>();
+        return run(request, [records](const web::json::value& page) {
+                       const auto& data = page.at(U("data")).as_array();
+                       records->insert(records->end(), data.begin(), data.end());
+                   }, page_size, max_in_flight, token)
+            .then([records](web::json::value summary) {
+                if (summary.has_field(U("error"))) return summary;
+                summary[U("data")] = web::json::value::array(*records);
+                return summary;
+            });
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef RECORDING_TRANSPORT_H
+#define RECORDING_TRANSPORT_H
+
+#include <cpprest/http_client.h>
+#include <pplx/pplx.h>
+#include "Transport.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// File a recording of method + relative URI is stored under:
+// FNV-1a of both, in hex, plus ".http". Callers pass the URI decoded, so
+// client and server agree however either side escapes it.
+inline std::string recording_file_name(const std::string& method, const std::string& relative_uri) {
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(method);
+    mix(" ");
+    mix(relative_uri);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.http", static_cast<unsigned long long>(hash));
+    return name;
+}
+
+// One recorded exchange. On disk it is laid out like an HTTP response:
+// "HTTP <status>", one "Name: value" line per header, an empty line, then
+// the body bytes.
+struct Recording {
+    unsigned short status = 0;
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::vector<unsigned char> body;
+
+    bool save(const std::string& path) const {
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+            out << "HTTP " << status << "\n";
+            for (const auto& header : headers) out << header.first << ": " << header.second << "\n";
+            out << "\n";
+            out.write(reinterpret_cast<const char*>(body.data()), body.size());
+            if (!out) return false;
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        std::string line;
+        if (!std::getline(in, line) || line.compare(0, 5, "HTTP ") != 0) return false;
+        status = static_cast<unsigned short>(std::atoi(line.c_str() + 5));
+        headers.clear();
+        while (std::getline(in, line) && !line.empty()) {
+            size_t colon = line.find(": ");
+            if (colon != std::string::npos) headers.emplace_back(line.substr(0, colon), line.substr(colon + 2));
+        }
+        std::ostringstream rest;
+        rest << in.rdbuf();
+        std::string bytes = rest.str();
+        body.assign(bytes.begin(), bytes.end());
+        return true;
+    }
+};
+
+// Passes requests to an inner transport and writes every response to
+// directory (which must exist) before handing it on, for ReplayServer to
+// serve later. Existing recordings of the same request are replaced. A
+// response that cannot be written fails the send, so the call reports the
+// error instead of passing on a response that was never recorded.
+// Conditional requests and 304 responses are passed through unrecorded:
+// the recording is keyed on method and URI only, and a revalidation must
+// not replace the full response recorded for them.
+class RecordingTransport : public Transport {
+private:
+    std::shared_ptr<Transport> inner;
+    std::string directory;
+
+    static bool conditional(const web::http::http_request& request) {
+        return request.headers().has(U("If-None-Match")) || request.headers().has(U("If-Modified-Since"));
+    }
+
+public:
+    RecordingTransport(std::shared_ptr<Transport> inner, const std::string& directory)
+        : inner(std::move(inner)), directory(directory) {}
+
+    pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) override {
+        if (conditional(request)) return inner->send(request, token);
+
+        std::string path = directory + "/" + recording_file_name(
+            utility::conversions::to_utf8string(request.method()),
+            utility::conversions::to_utf8string(web::uri::decode(request.request_uri().to_string())));
+
+        return inner->send(request, token).then([path](web::http::http_response response) {
+            if (response.status_code() == web::http::status_codes::NotModified) return pplx::task_from_result(response);
+
+            return response.extract_vector().then([path, response](std::vector<unsigned char> body) {
+                Recording recording;
+                recording.status = response.status_code();
+                for (const auto& header : response.headers()) {
+                    recording.headers.emplace_back(utility::conversions::to_utf8string(header.first),
+                                                   utility::conversions::to_utf8string(header.second));
+                }
+                recording.body = body;
+                if (!recording.save(path)) throw std::runtime_error("RecordingTransport: cannot write " + path);
+
+                // The body has been consumed; hand on a copy with the
+                // original headers (set_body would mark it as binary).
+                web::http::http_response replayed(response.status_code());
+                replayed.set_body(body);
+                for (const auto& header : recording.headers) {
+                    if (header.first == "Content-Length" || header.first == "Transfer-Encoding") continue;
+                    replayed.headers()[utility::conversions::to_string_t(header.first)] =
+                        utility::conversions::to_string_t(header.second);
+                }
+                return replayed;
+            });
+        });
+    }
+};
+
+#endif
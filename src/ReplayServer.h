@@ -0,0 +1,121 @@
+#ifndef REPLAY_SERVER_H
+#define REPLAY_SERVER_H
+
+#include <cpprest/http_client.h>
+#include <cpprest/http_listener.h>
+#include <pplx/pplx.h>
+#include "RecordingTransport.h"
+#include "TimerQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct ReplayOptions {
+    // Added before every response.
+    std::chrono::milliseconds latency = std::chrono::milliseconds(0);
+    // Body bytes per second; 0 sends the whole body at once.
+    size_t bytes_per_second = 0;
+    // Size of the pieces a throttled body is written in.
+    size_t chunk_size = 16 * 1024;
+};
+
+// Local HTTP server that answers requests from the files a
+// RecordingTransport wrote, so the client can be exercised offline:
+//   ReplayServer server("http://127.0.0.1:34570/v2", "recordings");
+//   server.open().wait();
+//   OpenDataHubAPI api(4, "http://127.0.0.1:34570/v2");
+// Requests are matched on method and URI relative to the listening path;
+// unknown ones get a 404. Recordings are read on first use and kept.
+class ReplayServer {
+private:
+    std::string directory;
+    ReplayOptions options;
+    std::mutex recordings_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Recording>> recordings;
+    TimerQueue timers;
+    // Declared after what its handler uses, so it is closed first.
+    web::http::experimental::listener::http_listener listener;
+
+    std::shared_ptr<const Recording> find(const std::string& file) {
+        std::lock_guard<std::mutex> lock(recordings_mutex);
+        auto it = recordings.find(file);
+        if (it != recordings.end()) return it->second;
+
+        auto recording = std::make_shared<Recording>();
+        if (!recording->load(directory + "/" + file)) recording.reset();
+        recordings.emplace(file, recording);
+        return recording;
+    }
+
+    void handle(web::http::http_request request) {
+        auto recording = find(recording_file_name(utility::conversions::to_utf8string(request.method()),
+                                                  utility::conversions::to_utf8string(web::uri::decode(request.relative_uri().to_string()))));
+        if (!recording) {
+            request.reply(web::http::status_codes::NotFound);
+            return;
+        }
+        timers.schedule_after(options.latency, [this, request, recording]() { reply(request, recording); });
+    }
+
+    void reply(web::http::http_request request, std::shared_ptr<const Recording> recording) {
+        web::http::http_response response(recording->status);
+        std::string content_type = "application/json";
+        for (const auto& header : recording->headers) {
+            if (header.first == "Content-Type") content_type = header.second;
+        }
+
+        if (options.bytes_per_second == 0) {
+            response.set_body(recording->body);
+            copy_headers(*recording, response);
+            request.reply(response);
+            return;
+        }
+
+        concurrency::streams::producer_consumer_buffer<uint8_t> buffer;
+        response.set_body(buffer.create_istream(), recording->body.size(), utility::conversions::to_string_t(content_type));
+        copy_headers(*recording, response);
+        request.reply(response);
+        write_chunk(buffer, recording, 0);
+    }
+
+    static void copy_headers(const Recording& recording, web::http::http_response& response) {
+        for (const auto& header : recording.headers) {
+            if (header.first == "Content-Length" || header.first == "Transfer-Encoding") continue;
+            response.headers()[utility::conversions::to_string_t(header.first)] = utility::conversions::to_string_t(header.second);
+        }
+    }
+
+    // Writes the next chunk of the body, then sleeps for as long as that
+    // chunk takes at the configured bandwidth before writing the one after.
+    void write_chunk(concurrency::streams::producer_consumer_buffer<uint8_t> buffer,
+                     std::shared_ptr<const Recording> recording, size_t offset) {
+        size_t length = std::min(options.chunk_size, recording->body.size() - offset);
+        if (length == 0) {
+            buffer.close(std::ios_base::out);
+            return;
+        }
+        auto pause = std::chrono::microseconds(static_cast<long long>(length) * 1000000 / static_cast<long long>(options.bytes_per_second));
+        buffer.putn_nocopy(recording->body.data() + offset, length).then([this, buffer, recording, offset, length, pause](size_t) {
+            timers.schedule_after(pause, [this, buffer, recording, offset, length]() {
+                write_chunk(buffer, recording, offset + length);
+            });
+        });
+    }
+
+public:
+    ReplayServer(const std::string& url, const std::string& directory, const ReplayOptions& options = ReplayOptions())
+        : directory(directory), options(options), listener(utility::conversions::to_string_t(url)) {
+        listener.support([this](web::http::http_request request) { handle(request); });
+    }
+
+    ReplayServer(const ReplayServer&) = delete;
+    ReplayServer& operator=(const ReplayServer&) = delete;
+
+    pplx::task<void> open() { return listener.open(); }
+    pplx::task<void> close() { return listener.close(); }
+};
+
+#endif
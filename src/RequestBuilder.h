@@ -0,0 +1,110 @@
+#ifndef REQUEST_BUILDER_H
+#define REQUEST_BUILDER_H
+
+#include <cstddef>
+#include <string>
+
+// Writes a request path and query string into one reusable buffer, percent-
+// encoding each segment and value exactly once (everything except RFC 3986
+// unreserved characters, like web::uri::encode_data_string). After the
+// first few requests the buffer has grown to its working size and building
+// a URL no longer allocates.
+class RequestBuilder {
+private:
+    std::string buffer;
+    bool has_query = false;
+
+    void append_encoded(const char* text, size_t length) {
+        static const char hex[] = "0123456789ABCDEF";
+        for (size_t i = 0; i < length; ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+                c == '-' || c == '.' || c == '_' || c == '~') {
+                buffer += static_cast<char>(c);
+            } else {
+                buffer += '%';
+                buffer += hex[c >> 4];
+                buffer += hex[c & 0x0F];
+            }
+        }
+    }
+
+    void begin_param(const char* name) {
+        buffer += has_query ? '&' : '?';
+        buffer += name;
+        buffer += '=';
+        has_query = true;
+    }
+
+public:
+    RequestBuilder& reset() {
+        buffer.clear();
+        has_query = false;
+        return *this;
+    }
+
+    // Appends "/" followed by the encoded value.
+    RequestBuilder& segment(const std::string& value) {
+        buffer += '/';
+        append_encoded(value.data(), value.size());
+        return *this;
+    }
+
+    // Appends path text verbatim, e.g. "/latest".
+    RequestBuilder& path(const char* text) {
+        buffer += text;
+        return *this;
+    }
+
+    // Appends name=value; empty values are skipped.
+    RequestBuilder& param(const char* name, const std::string& value) {
+        if (value.empty()) return *this;
+        begin_param(name);
+        append_encoded(value.data(), value.size());
+        return *this;
+    }
+
+    RequestBuilder& param(const char* name, long long value) {
+        char digits[24];
+        size_t length = 0;
+        unsigned long long magnitude = value < 0 ? 0ULL - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+        do {
+            digits[length++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+
+        begin_param(name);
+        if (value < 0) buffer += '-';
+        while (length > 0) buffer += digits[--length];
+        return *this;
+    }
+
+    // The common paging and filtering parameters of the query endpoints,
+    // each emitted only when it differs from the API default.
+    RequestBuilder& query(int limit, int offset, const std::string& select, const std::string& where,
+                          bool shownull, bool distinct) {
+        if (limit != 200) param("limit", limit);
+        if (offset != 0) param("offset", offset);
+        param("select", select);
+        param("where", where);
+        if (shownull) param("shownull", std::string("true"));
+        if (!distinct) param("distinct", std::string("false"));
+        return *this;
+    }
+
+    const std::string& str() const { return buffer; }
+};
+
+// Quotes a value for use in a where filter ("scode.eq.<value>") when it
+// contains characters the filter syntax treats specially.
+inline std::string quote_where_value(const std::string& value) {
+    if (value.find_first_of(",()\"") == std::string::npos) return value;
+    std::string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+#endif
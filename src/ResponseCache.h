@@ -0,0 +1,220 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <cpprest/json.h>
+#include <pplx/pplx.h>
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// In-process cache of successful JSON responses keyed on the request path
+// and query. Entries expire after a per-call TTL and are evicted least
+// recently used first once their combined estimated DOM size (see
+// estimated_size) exceeds the capacity. Bodies are shared immutably and
+// copied for the caller outside the lock.
+// Expired entries that carried an ETag or Last-Modified header are
+// revalidated with a conditional request instead of refetched, and
+// concurrent requests for the same key share one in-flight fetch. Must be
+// owned by a shared_ptr: a fetch in flight keeps the cache alive.
+class ResponseCache : public std::enable_shared_from_this<ResponseCache> {
+public:
+    // Outcome of one upstream request made on behalf of the cache.
+    struct Fetched {
+        bool not_modified = false;
+        bool cacheable = false;
+        web::json::value body;
+        // estimated_size(body)
+        size_t bytes = 0;
+        std::string etag;
+        std::string last_modified;
+    };
+
+    // Rough heap footprint of a parsed json::value: a node per value plus
+    // the characters of strings and keys. The DOM is typically several
+    // times larger than the response text it was parsed from.
+    static size_t estimated_size(const web::json::value& value) {
+        size_t bytes = sizeof(web::json::value) + 48;
+        if (value.is_string()) {
+            bytes += value.as_string().size() * sizeof(utility::char_t) + 32;
+        } else if (value.is_array()) {
+            for (const auto& element : value.as_array()) bytes += estimated_size(element);
+        } else if (value.is_object()) {
+            for (const auto& field : value.as_object()) {
+                bytes += field.first.size() * sizeof(utility::char_t) + 32 + estimated_size(field.second);
+            }
+        }
+        return bytes;
+    }
+
+    // Called with the validators of the stale entry (empty if none).
+    typedef std::function<pplx::task<Fetched>(const std::string& etag, const std::string& last_modified)> Fetcher;
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Entry {
+        std::shared_ptr<const web::json::value> body;
+        size_t bytes;
+        std::string etag;
+        std::string last_modified;
+        clock::time_point expires;
+        std::list<std::string>::iterator lru_position;
+    };
+
+    std::mutex mutex;
+    size_t capacity_bytes;
+    size_t used_bytes = 0;
+    std::list<std::string> lru;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> entries;
+    std::unordered_map<std::string, pplx::task<web::json::value>> in_flight;
+
+    void erase_locked(const std::string& key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) return;
+        used_bytes -= it->second->bytes;
+        lru.erase(it->second->lru_position);
+        entries.erase(it);
+    }
+
+    void store_locked(const std::string& key, const Fetched& fetched, std::chrono::milliseconds ttl) {
+        erase_locked(key);
+        if (fetched.bytes > capacity_bytes) return;
+
+        while (used_bytes + fetched.bytes > capacity_bytes && !lru.empty()) {
+            erase_locked(lru.back());
+        }
+
+        auto entry = std::make_shared<Entry>();
+        entry->body = std::make_shared<const web::json::value>(fetched.body);
+        entry->bytes = fetched.bytes;
+        entry->etag = fetched.etag;
+        entry->last_modified = fetched.last_modified;
+        entry->expires = clock::now() + ttl;
+        lru.push_front(key);
+        entry->lru_position = lru.begin();
+        entries[key] = entry;
+        used_bytes += fetched.bytes;
+    }
+
+    // Puts a revalidated entry back after it was evicted while the
+    // conditional request was in flight.
+    void reinsert_locked(const std::string& key, const std::shared_ptr<Entry>& stale, std::chrono::milliseconds ttl) {
+        erase_locked(key);
+        if (stale->bytes > capacity_bytes) return;
+        while (used_bytes + stale->bytes > capacity_bytes && !lru.empty()) {
+            erase_locked(lru.back());
+        }
+        auto entry = std::make_shared<Entry>(*stale);
+        entry->expires = clock::now() + ttl;
+        lru.push_front(key);
+        entry->lru_position = lru.begin();
+        entries[key] = entry;
+        used_bytes += entry->bytes;
+    }
+
+    void complete(const std::string& key, std::chrono::milliseconds ttl, std::shared_ptr<Entry> stale,
+                  pplx::task<Fetched> fetch, pplx::task_completion_event<web::json::value> done) {
+        web::json::value result;
+        try {
+            Fetched fetched = fetch.get();
+            std::shared_ptr<const web::json::value> revalidated;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (fetched.not_modified && stale) {
+                    auto it = entries.find(key);
+                    if (it != entries.end() && it->second == stale) {
+                        stale->expires = clock::now() + ttl;
+                        lru.splice(lru.begin(), lru, stale->lru_position);
+                    } else {
+                        reinsert_locked(key, stale, ttl);
+                    }
+                    revalidated = stale->body;
+                } else if (fetched.cacheable) {
+                    store_locked(key, fetched, ttl);
+                }
+                in_flight.erase(key);
+            }
+            // As for hits, the copy is made outside the lock.
+            result = revalidated ? *revalidated : std::move(fetched.body);
+        } catch (const std::exception& e) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                in_flight.erase(key);
+            }
+            result[U("error")] = web::json::value::string(
+                U("Exception: ") + utility::conversions::to_string_t(e.what()));
+            result[U("success")] = web::json::value::boolean(false);
+        }
+        done.set(result);
+    }
+
+public:
+    explicit ResponseCache(size_t capacity = 16 * 1024 * 1024) : capacity_bytes(capacity) {}
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    pplx::task<web::json::value> get(const std::string& key, std::chrono::milliseconds ttl, const Fetcher& fetch) {
+        std::shared_ptr<Entry> stale;
+        std::shared_ptr<const web::json::value> hit;
+        pplx::task_completion_event<web::json::value> done;
+        pplx::task<web::json::value> result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(key);
+            if (it != entries.end()) {
+                if (clock::now() < it->second->expires) {
+                    lru.splice(lru.begin(), lru, it->second->lru_position);
+                    hit = it->second->body;
+                } else {
+                    stale = it->second;
+                }
+            }
+
+            if (!hit) {
+                auto pending = in_flight.find(key);
+                if (pending != in_flight.end()) return pending->second;
+
+                result = pplx::create_task(done);
+                in_flight[key] = result;
+            }
+        }
+        // The copy handed to the caller is made outside the lock.
+        if (hit) return pplx::task_from_result(*hit);
+
+        std::string etag = stale ? stale->etag : "";
+        std::string last_modified = stale ? stale->last_modified : "";
+        auto self = shared_from_this();
+        fetch(etag, last_modified).then([self, key, ttl, stale, done](pplx::task<Fetched> fetched) {
+            self->complete(key, ttl, stale, fetched, done);
+        });
+        return result;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        lru.clear();
+        used_bytes = 0;
+    }
+
+    void set_capacity(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity_bytes = bytes;
+        while (used_bytes > capacity_bytes && !lru.empty()) {
+            erase_locked(lru.back());
+        }
+    }
+
+    size_t size_bytes() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used_bytes;
+    }
+};
+
+#endif
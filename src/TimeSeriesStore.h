@@ -0,0 +1,413 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include "MeasurementColumns.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// On-disk cache of historical measurements (POSIX only). Every
+// (station code, data type, period) series lives in its own directory;
+// a station may report one type at several periods (mperiod, in seconds),
+// and those series must not be merged:
+//
+//   <root>/<station>/<type>/<period>/YYYY-MM-DD.seg   append-only day partitions
+//   <root>/<station>/<type>/<period>/coverage.idx     time ranges fetched so far
+//
+// A segment is an 8-byte magic followed by blocks, each a uint64 row count,
+// that many int64 epoch ms timestamps and then that many double values.
+// Timestamps increase strictly across the blocks of a segment, so a range
+// of a block is two contiguous columns. Segments are read through mmap and
+// scan() hands out pointers into the mapping, so a restarted process can
+// answer from disk without parsing JSON or copying rows. Mappings stay open
+// between queries. Segments only grow or are replaced by rename, never
+// truncated in place, so a live mapping is always safe to read. The
+// coverage index is a sorted list of disjoint [from, to) pairs and tells
+// the caller which parts of a query still have to come from the API.
+class TimeSeriesStore {
+public:
+    struct Point {
+        int64_t timestamp;
+        double value;
+    };
+
+    typedef std::pair<int64_t, int64_t> Interval;
+
+private:
+    static const int64_t DAY_MS = 86400000;
+    // Blocks a segment may collect before an append rewrites it as one.
+    static const size_t MAX_BLOCKS = 64;
+    static const char* magic() { return "ODHSEG01"; }
+
+    struct Mapping {
+        const char* bytes = nullptr;
+        size_t size = 0;
+        dev_t device = 0;
+        ino_t inode = 0;
+        std::list<std::string>::iterator lru_position;
+
+        ~Mapping() {
+            if (bytes) munmap(const_cast<char*>(bytes), size);
+        }
+    };
+
+    std::string root;
+    size_t max_mapped;
+    std::mutex mutex;
+    std::list<std::string> mapped_lru;
+    std::unordered_map<std::string, std::shared_ptr<Mapping>> mapped;
+
+    static std::string escape(const std::string& name) {
+        static const char hex[] = "0123456789ABCDEF";
+        std::string escaped;
+        for (unsigned char c : name) {
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '_') {
+                escaped += static_cast<char>(c);
+            } else {
+                escaped += '%';
+                escaped += hex[c >> 4];
+                escaped += hex[c & 0x0F];
+            }
+        }
+        return escaped.empty() ? "%" : escaped;
+    }
+
+    static void make_directory(const std::string& path) {
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+            throw std::runtime_error("TimeSeriesStore: cannot create " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    static void write_all(int fd, const char* data, size_t length, const std::string& path) {
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) throw std::runtime_error("TimeSeriesStore: cannot write " + path + ": " + std::strerror(errno));
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+    }
+
+    std::string series_directory(const std::string& station, const std::string& type, int period, bool create) const {
+        std::string station_directory = root + "/" + escape(station);
+        std::string type_directory = station_directory + "/" + escape(type);
+        std::string period_directory = type_directory + "/" + std::to_string(period);
+        if (create) {
+            make_directory(root);
+            make_directory(station_directory);
+            make_directory(type_directory);
+            make_directory(period_directory);
+        }
+        return period_directory;
+    }
+
+    static int64_t day_of(int64_t timestamp) {
+        return timestamp >= 0 ? timestamp / DAY_MS : (timestamp - DAY_MS + 1) / DAY_MS;
+    }
+
+    static std::string segment_path(const std::string& directory, int64_t day) {
+        return directory + "/" + format_timestamp(day * DAY_MS).substr(0, 10) + ".seg";
+    }
+
+    void forget_locked(const std::string& path) {
+        auto it = mapped.find(path);
+        if (it == mapped.end()) return;
+        mapped_lru.erase(it->second->lru_position);
+        mapped.erase(it);
+    }
+
+    // The current mapping of a segment, or null if it does not exist or is
+    // not in this format. A mapping is reused until the file grows or is
+    // replaced.
+    std::shared_ptr<Mapping> map_locked(const std::string& path) {
+        struct stat info;
+        if (::stat(path.c_str(), &info) != 0) {
+            forget_locked(path);
+            return nullptr;
+        }
+        auto it = mapped.find(path);
+        if (it != mapped.end()) {
+            const Mapping& mapping = *it->second;
+            if (mapping.size == static_cast<size_t>(info.st_size) && mapping.device == info.st_dev && mapping.inode == info.st_ino) {
+                mapped_lru.splice(mapped_lru.begin(), mapped_lru, it->second->lru_position);
+                return it->second;
+            }
+            forget_locked(path);
+        }
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < 8) {
+            ::close(fd);
+            return nullptr;
+        }
+        auto mapping = std::make_shared<Mapping>();
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) return nullptr;
+        mapping->bytes = static_cast<const char*>(address);
+        mapping->size = static_cast<size_t>(info.st_size);
+        mapping->device = info.st_dev;
+        mapping->inode = info.st_ino;
+        if (std::memcmp(mapping->bytes, magic(), 8) != 0) return nullptr;
+
+        mapped_lru.push_front(path);
+        mapping->lru_position = mapped_lru.begin();
+        mapped[path] = mapping;
+        while (mapped.size() > max_mapped) forget_locked(mapped_lru.back());
+        return mapping;
+    }
+
+    // Calls visit(timestamps, values, count) for every complete block of a
+    // segment. Returns false if the segment ends in a torn block, which is
+    // then ignored.
+    template <typename Visitor>
+    static bool for_each_block(const Mapping& segment, Visitor visit) {
+        size_t offset = 8;
+        while (offset < segment.size) {
+            if (segment.size - offset < 8) return false;
+            uint64_t count;
+            std::memcpy(&count, segment.bytes + offset, 8);
+            offset += 8;
+            if (count > (segment.size - offset) / (sizeof(int64_t) + sizeof(double))) return false;
+            size_t rows = static_cast<size_t>(count);
+            if (rows > 0) {
+                visit(reinterpret_cast<const int64_t*>(segment.bytes + offset),
+                      reinterpret_cast<const double*>(segment.bytes + offset + rows * sizeof(int64_t)), rows);
+            }
+            offset += rows * (sizeof(int64_t) + sizeof(double));
+        }
+        return true;
+    }
+
+    // Serializes one block, preceded by the magic for a new segment.
+    static std::vector<char> encode_block(const int64_t* timestamps, const double* values, size_t count, bool with_magic) {
+        uint64_t rows = count;
+        std::vector<char> block((with_magic ? 8 : 0) + 8 + count * (sizeof(int64_t) + sizeof(double)));
+        char* out = block.data();
+        if (with_magic) {
+            std::memcpy(out, magic(), 8);
+            out += 8;
+        }
+        std::memcpy(out, &rows, 8);
+        std::memcpy(out + 8, timestamps, count * sizeof(int64_t));
+        std::memcpy(out + 8 + count * sizeof(int64_t), values, count * sizeof(double));
+        return block;
+    }
+
+    // Adds sorted, unique points to a day segment. They are appended as one
+    // block when they all come after the stored ones; otherwise the segment
+    // is merged with them, later values winning, and replaced.
+    void append_segment_locked(const std::string& path, const std::vector<int64_t>& timestamps, const std::vector<double>& values) {
+        auto segment = map_locked(path);
+        int64_t last = std::numeric_limits<int64_t>::min();
+        size_t blocks = 0;
+        bool intact = segment && for_each_block(*segment, [&](const int64_t* stored, const double*, size_t count) {
+            last = stored[count - 1];
+            ++blocks;
+        });
+
+        if (intact && timestamps.front() > last && blocks < MAX_BLOCKS) {
+            auto block = encode_block(timestamps.data(), values.data(), timestamps.size(), false);
+            int fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+            if (fd < 0) throw std::runtime_error("TimeSeriesStore: cannot open " + path + ": " + std::strerror(errno));
+            try {
+                write_all(fd, block.data(), block.size(), path);
+            } catch (...) {
+                ::close(fd);
+                throw;
+            }
+            ::close(fd);
+            forget_locked(path);
+            return;
+        }
+
+        std::vector<int64_t> merged_timestamps;
+        std::vector<double> merged_values;
+        size_t next = 0;
+        auto merge = [&](const int64_t* stored, const double* stored_values, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                while (next < timestamps.size() && timestamps[next] < stored[i]) {
+                    merged_timestamps.push_back(timestamps[next]);
+                    merged_values.push_back(values[next++]);
+                }
+                if (next < timestamps.size() && timestamps[next] == stored[i]) continue;
+                merged_timestamps.push_back(stored[i]);
+                merged_values.push_back(stored_values[i]);
+            }
+        };
+        if (segment) for_each_block(*segment, merge);
+        merged_timestamps.insert(merged_timestamps.end(), timestamps.begin() + next, timestamps.end());
+        merged_values.insert(merged_values.end(), values.begin() + next, values.end());
+
+        auto contents = encode_block(merged_timestamps.data(), merged_values.data(), merged_timestamps.size(), true);
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("TimeSeriesStore: cannot write " + temporary + ": " + std::strerror(errno));
+        try {
+            write_all(fd, contents.data(), contents.size(), temporary);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("TimeSeriesStore: cannot replace " + path + ": " + std::strerror(errno));
+        }
+        forget_locked(path);
+    }
+
+    static std::vector<Interval> read_coverage(const std::string& directory) {
+        std::vector<Interval> coverage;
+        int fd = ::open((directory + "/coverage.idx").c_str(), O_RDONLY);
+        if (fd < 0) return coverage;
+
+        int64_t pair[2];
+        while (::read(fd, pair, sizeof(pair)) == static_cast<ssize_t>(sizeof(pair))) {
+            coverage.push_back(Interval(pair[0], pair[1]));
+        }
+        ::close(fd);
+        return coverage;
+    }
+
+    static void write_coverage(const std::string& directory, const std::vector<Interval>& coverage) {
+        std::string path = directory + "/coverage.idx";
+        std::string temporary = path + ".tmp";
+        int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("TimeSeriesStore: cannot write " + temporary + ": " + std::strerror(errno));
+
+        std::vector<int64_t> flat;
+        for (const auto& interval : coverage) {
+            flat.push_back(interval.first);
+            flat.push_back(interval.second);
+        }
+        try {
+            write_all(fd, reinterpret_cast<const char*>(flat.data()), flat.size() * sizeof(int64_t), temporary);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        if (::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("TimeSeriesStore: cannot replace " + path + ": " + std::strerror(errno));
+        }
+    }
+
+public:
+    // At most max_mapped_segments segment mappings are kept open between
+    // queries, least recently used first out.
+    explicit TimeSeriesStore(const std::string& directory, size_t max_mapped_segments = 1024)
+        : root(directory), max_mapped(max_mapped_segments) {}
+
+    TimeSeriesStore(const TimeSeriesStore&) = delete;
+    TimeSeriesStore& operator=(const TimeSeriesStore&) = delete;
+
+    // Calls visit(timestamps, values, count) with the stored points of one
+    // series in [from, to), in increasing timestamp order and without
+    // duplicates. The pointers go straight into the mapped segments and are
+    // only valid during the call; visit must not call back into the store.
+    template <typename Visitor>
+    void scan(const std::string& station, const std::string& type, int period, int64_t from, int64_t to, Visitor visit) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (from >= to) return;
+
+        std::string directory = series_directory(station, type, period, false);
+        for (int64_t day = day_of(from); day <= day_of(to - 1); ++day) {
+            auto segment = map_locked(segment_path(directory, day));
+            if (!segment) continue;
+            for_each_block(*segment, [&](const int64_t* timestamps, const double* values, size_t count) {
+                size_t begin = std::lower_bound(timestamps, timestamps + count, from) - timestamps;
+                size_t end = std::lower_bound(timestamps + begin, timestamps + count, to) - timestamps;
+                if (begin < end) visit(timestamps + begin, values + begin, end - begin);
+            });
+        }
+    }
+
+    // Stored points of one series in [from, to), sorted by timestamp. If a
+    // timestamp was stored more than once the most recently appended value wins.
+    std::vector<Point> read(const std::string& station, const std::string& type, int period, int64_t from, int64_t to) {
+        std::vector<Point> points;
+        scan(station, type, period, from, to, [&points](const int64_t* timestamps, const double* values, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                Point point = { timestamps[i], values[i] };
+                points.push_back(point);
+            }
+        });
+        return points;
+    }
+
+    // Parts of [from, to) that have never been stored for this series.
+    std::vector<Interval> missing(const std::string& station, const std::string& type, int period, int64_t from, int64_t to) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<Interval> gaps;
+        int64_t cursor = from;
+        for (const auto& covered : read_coverage(series_directory(station, type, period, false))) {
+            if (covered.second <= cursor) continue;
+            if (covered.first >= to) break;
+            if (covered.first > cursor) gaps.push_back(Interval(cursor, covered.first));
+            cursor = std::max(cursor, covered.second);
+        }
+        if (cursor < to) gaps.push_back(Interval(cursor, to));
+        return gaps;
+    }
+
+    // Appends the points that fall into covered and records covered as
+    // fetched. Points outside covered are ignored.
+    void append(const std::string& station, const std::string& type, int period, const std::vector<Point>& points, Interval covered) {
+        if (covered.first >= covered.second) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string directory = series_directory(station, type, period, true);
+
+        std::vector<Point> sorted;
+        for (const auto& point : points) {
+            if (point.timestamp >= covered.first && point.timestamp < covered.second) sorted.push_back(point);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Point& a, const Point& b) { return a.timestamp < b.timestamp; });
+
+        for (size_t start = 0; start < sorted.size();) {
+            int64_t day = day_of(sorted[start].timestamp);
+            std::vector<int64_t> timestamps;
+            std::vector<double> values;
+            size_t end = start;
+            for (; end < sorted.size() && day_of(sorted[end].timestamp) == day; ++end) {
+                if (!timestamps.empty() && timestamps.back() == sorted[end].timestamp) {
+                    values.back() = sorted[end].value;
+                } else {
+                    timestamps.push_back(sorted[end].timestamp);
+                    values.push_back(sorted[end].value);
+                }
+            }
+            append_segment_locked(segment_path(directory, day), timestamps, values);
+            start = end;
+        }
+
+        std::vector<Interval> coverage = read_coverage(directory);
+        coverage.push_back(covered);
+        std::sort(coverage.begin(), coverage.end());
+        std::vector<Interval> merged;
+        for (const auto& interval : coverage) {
+            if (!merged.empty() && interval.first <= merged.back().second) {
+                merged.back().second = std::max(merged.back().second, interval.second);
+            } else {
+                merged.push_back(interval);
+            }
+        }
+        write_coverage(directory, merged);
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef TIMER_QUEUE_H
+#define TIMER_QUEUE_H
+
+#include <pplx/pplx.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Calls on_cancel if token is canceled before done has completed (right
+// away if it already is), and unregisters it once done has completed.
+template <typename T>
+void cancel_until_done(const pplx::cancellation_token& token, const pplx::task<T>& done, const std::function<void()>& on_cancel) {
+    if (!token.is_cancelable()) return;
+    auto registration = token.register_callback(on_cancel);
+    done.then([token, registration](pplx::task<T>) { token.deregister_callback(registration); });
+}
+
+// One background thread that runs callbacks at (or shortly after) a given
+// time. pplx has no portable timer, so delays, poll intervals and deadlines
+// are all scheduled here. Callbacks run on the timer thread and should only
+// kick off asynchronous work. Timers still pending when the queue is
+// destroyed do not run; their on_cancel callbacks run instead, so delay()
+// tasks end as canceled rather than never completing.
+class TimerQueue {
+public:
+    typedef std::chrono::steady_clock clock;
+    // Identifies a scheduled timer for cancel(); ordered by due time.
+    typedef std::pair<clock::time_point, uint64_t> TimerId;
+
+private:
+    struct Timer {
+        std::function<void()> callback;
+        std::function<void()> on_cancel;
+    };
+
+    // Owned jointly by the queue and its thread, so the queue may also be
+    // destroyed from one of its own callbacks.
+    struct State {
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::map<TimerId, Timer> timers;
+        uint64_t next_sequence = 0;
+        bool stopping = false;
+    };
+
+    std::shared_ptr<State> state;
+    std::thread worker;
+
+    static void run(std::shared_ptr<State> state) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        while (!state->stopping) {
+            if (state->timers.empty()) {
+                state->wakeup.wait(lock);
+                continue;
+            }
+            auto next = state->timers.begin();
+            if (clock::now() < next->first.first) {
+                state->wakeup.wait_until(lock, next->first.first);
+                continue;
+            }
+            auto callback = next->second.callback;
+            state->timers.erase(next);
+            lock.unlock();
+            callback();
+            lock.lock();
+        }
+    }
+
+public:
+    TimerQueue() : state(std::make_shared<State>()) {}
+
+    TimerQueue(const TimerQueue&) = delete;
+    TimerQueue& operator=(const TimerQueue&) = delete;
+
+    ~TimerQueue() {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->stopping = true;
+        }
+        state->wakeup.notify_one();
+        if (worker.joinable()) {
+            if (worker.get_id() == std::this_thread::get_id()) {
+                worker.detach();
+            } else {
+                worker.join();
+            }
+        }
+
+        std::vector<std::function<void()>> cancels;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            for (const auto& timer : state->timers) cancels.push_back(timer.second.on_cancel);
+            state->timers.clear();
+        }
+        for (auto& on_cancel : cancels) {
+            if (on_cancel) on_cancel();
+        }
+    }
+
+    // on_cancel runs instead of callback if the queue is destroyed first.
+    TimerId schedule_at(clock::time_point due, const std::function<void()>& callback,
+                        const std::function<void()>& on_cancel = nullptr) {
+        // Rejected timers get an id no timer can have.
+        TimerId id(due, UINT64_MAX);
+        bool accepted = false;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (!state->stopping) {
+                accepted = true;
+                if (!worker.joinable()) worker = std::thread(&TimerQueue::run, state);
+                id.second = state->next_sequence++;
+                Timer& timer = state->timers[id];
+                timer.callback = callback;
+                timer.on_cancel = on_cancel;
+            }
+        }
+        if (!accepted) {
+            if (on_cancel) on_cancel();
+            return id;
+        }
+        state->wakeup.notify_one();
+        return id;
+    }
+
+    TimerId schedule_after(clock::duration delay, const std::function<void()>& callback,
+                           const std::function<void()>& on_cancel = nullptr) {
+        return schedule_at(clock::now() + delay, callback, on_cancel);
+    }
+
+    // Removes a timer that has not run yet; neither of its callbacks runs.
+    // Returns false if it already ran or was removed.
+    bool cancel(const TimerId& id) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        return state->timers.erase(id) > 0;
+    }
+
+    // Task that completes after delay without holding a pplx worker thread.
+    // It is canceled if the queue is destroyed first or token is canceled;
+    // the timer is removed then, not left to run out.
+    pplx::task<void> delay(clock::duration delay, const pplx::cancellation_token& token = pplx::cancellation_token::none()) {
+        pplx::task_completion_event<void> done;
+        auto id = schedule_after(delay, [done]() { done.set(); },
+                                 [done]() { done.set_exception(pplx::task_canceled()); });
+        auto waited = pplx::create_task(done);
+
+        std::weak_ptr<State> weak = state;
+        cancel_until_done(token, waited, [weak, id, done]() {
+            auto timers = weak.lock();
+            if (!timers) return;
+            bool removed;
+            {
+                std::lock_guard<std::mutex> lock(timers->mutex);
+                removed = timers->timers.erase(id) > 0;
+            }
+            if (removed) done.set_exception(pplx::task_canceled());
+        });
+        return waited;
+    }
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <cpprest/http_client.h>
+#include <pplx/pplx.h>
+#include "HttpClientPool.h"
+#include <memory>
+#include <string>
+
+// Delivers a built request (its URI relative to the API base) and resolves
+// to the response. OpenDataHubAPI sends every request through one of these,
+// after admission control, so implementations only move bytes.
+class Transport {
+public:
+    virtual ~Transport() {}
+
+    virtual pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) = 0;
+};
+
+// Default transport: cpprest http_client instances from an HttpClientPool.
+class HttpTransport : public Transport {
+private:
+    HttpClientPool pool;
+
+public:
+    HttpTransport(const std::string& base, const web::http::client::http_client_config& config, size_t pool_size)
+        : pool(base, config, pool_size) {}
+
+    pplx::task<web::http::http_response> send(web::http::http_request request, const pplx::cancellation_token& token) override {
+        auto client = pool.acquire();
+        // Holds the client until the response arrives; with pooling off it
+        // is the only reference.
+        return client->request(request, token).then([client](web::http::http_response response) { return response; });
+    }
+
+    size_t pool_size() const { return pool.size(); }
+};
+
+#endif